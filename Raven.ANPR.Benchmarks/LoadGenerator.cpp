@@ -0,0 +1,314 @@
+#define _USE_MATH_DEFINES
+#include <recognizer/plate_recognizer.h>
+#include <recognizer/plate_finder_by_geometry.hpp>
+#include "recognizer/plate_finder_by_rectangle.hpp"
+#include "recognizer/char_classifier_backend.hpp"
+#include "recognizer/tesseract_ocr_backend.h"
+#include "synthetic_plates.hpp"
+#include "bench_stats.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+//replays frames through plate_recognizer at a given concurrency and frame rate, and reports throughput, latency and accuracy
+//the frames are decoded up front, so the numbers are about recognition only (not about the disk)
+//usage:
+//  Raven.ANPR.LoadGenerator [--frames <directory>] [--labels <csv>] [--synthetic <count>] [--resolution WxH]
+//                           [--concurrency N] [--fps N] [--count N] [--cascade] [--parallel-strategies]
+//                           [--expected-plate-height N] [--char-classifier] [--output report.json]
+//the labels are a csv with "file,plate_number" lines (see golden_labels.csv), frames without a label don't count for accuracy
+
+using json = nlohmann::json;
+using load_clock = std::chrono::steady_clock;
+
+struct load_frame
+{
+	std::string name;
+	cv::Mat image;
+
+	//expected plate number, empty if not known
+	std::string label;
+};
+
+struct load_options
+{
+	std::string frames_directory;
+	std::string labels_path;
+	size_t synthetic_frames = 0;
+	cv::Size synthetic_resolution { 1280, 720 };
+
+	size_t concurrency = 1;
+
+	//zero means as fast as possible
+	double target_fps = 0;
+
+	//how many frames to send in total, zero means each frame once
+	size_t frame_count = 0;
+
+	bool cascade = false;
+	bool parallel_strategies = false;
+	double expected_plate_height = 0;
+	bool char_classifier = false;
+
+	std::string output_path;
+};
+
+std::map<std::string, std::string> load_labels(const std::string& path)
+{
+	std::map<std::string, std::string> labels;
+	if(path.empty())
+		return labels;
+
+	std::ifstream file(path);
+	if(!file)
+		throw std::runtime_error("Failed to open the labels file " + path);
+
+	std::string line;
+	while(std::getline(file, line))
+	{
+		if(!line.empty() && line.back() == '\r')
+			line.pop_back();
+
+		const auto separator = line.find(',');
+		if(separator == std::string::npos || line.compare(0, separator, "file") == 0)
+			continue;
+
+		labels[line.substr(0, separator)] = line.substr(separator + 1);
+	}
+
+	return labels;
+}
+
+std::vector<load_frame> load_frames(const load_options& options)
+{
+	std::vector<load_frame> frames;
+	const auto labels = load_labels(options.labels_path);
+
+	if(!options.frames_directory.empty())
+	{
+		std::vector<std::filesystem::path> paths;
+		for(const auto& entry : std::filesystem::directory_iterator(options.frames_directory))
+		{
+			auto extension = entry.path().extension().string();
+			std::transform(extension.begin(), extension.end(), extension.begin(), [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			if(entry.is_regular_file() && (extension == ".jpg" || extension == ".jpeg" || extension == ".png" || extension == ".bmp"))
+				paths.push_back(entry.path());
+		}
+
+		//directory order is not defined, sorting makes the runs repeatable
+		std::sort(paths.begin(), paths.end());
+
+		for(const auto& path : paths)
+		{
+			auto image = cv::imread(path.string());
+			if(image.data == nullptr)
+			{
+				std::cerr << "skipping " << path << " (failed to load)" << std::endl;
+				continue;
+			}
+
+			const auto name = path.filename().string();
+			const auto label = labels.find(name);
+			frames.push_back({ name, image, label != labels.end() ? label->second : std::string() });
+		}
+	}
+
+	//synthetic frames always know their plate number
+	std::mt19937 random(42);
+	for(size_t i = 0; i < options.synthetic_frames; i++)
+	{
+		auto plate_number = make_synthetic_plate_number(random);
+		std::ostringstream name;
+		name << "synthetic_" << i;
+		frames.push_back({ name.str(), make_synthetic_plate(options.synthetic_resolution, plate_number, random), plate_number });
+	}
+
+	return frames;
+}
+
+bool parse_arguments(const int argc, char* argv[], load_options& options)
+{
+	for(auto i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		const auto has_value = i + 1 < argc;
+
+		if(arg == "--frames" && has_value)
+			options.frames_directory = argv[++i];
+		else if(arg == "--labels" && has_value)
+			options.labels_path = argv[++i];
+		else if(arg == "--synthetic" && has_value)
+			options.synthetic_frames = std::stoul(argv[++i]);
+		else if(arg == "--resolution" && has_value)
+		{
+			const std::string resolution = argv[++i];
+			const auto separator = resolution.find('x');
+			if(separator == std::string::npos)
+				return false;
+			options.synthetic_resolution = cv::Size(std::stoi(resolution.substr(0, separator)), std::stoi(resolution.substr(separator + 1)));
+		}
+		else if(arg == "--concurrency" && has_value)
+			options.concurrency = std::max<size_t>(1, std::stoul(argv[++i]));
+		else if(arg == "--fps" && has_value)
+			options.target_fps = std::stod(argv[++i]);
+		else if(arg == "--count" && has_value)
+			options.frame_count = std::stoul(argv[++i]);
+		else if(arg == "--cascade")
+			options.cascade = true;
+		else if(arg == "--parallel-strategies")
+			options.parallel_strategies = true;
+		else if(arg == "--expected-plate-height" && has_value)
+			options.expected_plate_height = std::stod(argv[++i]);
+		else if(arg == "--char-classifier")
+			options.char_classifier = true;
+		else if(arg == "--output" && has_value)
+			options.output_path = argv[++i];
+		else
+			return false;
+	}
+
+	return !options.frames_directory.empty() || options.synthetic_frames > 0;
+}
+
+int main(int argc, char* argv[])
+{
+	load_options options;
+	if(!parse_arguments(argc, argv, options))
+	{
+		std::cerr << "usage: " << argv[0] << " [--frames <directory>] [--labels <csv>] [--synthetic <count>] [--resolution WxH]" << std::endl
+			<< "       [--concurrency N] [--fps N] [--count N] [--cascade] [--parallel-strategies]" << std::endl
+			<< "       [--expected-plate-height N] [--char-classifier] [--output report.json]" << std::endl;
+		return 1;
+	}
+
+	const auto frames = load_frames(options);
+	if(frames.empty())
+	{
+		std::cerr << "no frames to replay" << std::endl;
+		return 1;
+	}
+
+	recognizer_options settings;
+	settings.enable_metrics = true;
+	settings.cascade = options.cascade;
+	settings.parallel_strategies = options.parallel_strategies;
+	settings.expected_plate_height = options.expected_plate_height;
+
+	//the per-character classifier reads what it can and leaves the rest to tesseract
+	std::shared_ptr<char_classifier_backend> classifier;
+	std::shared_ptr<ocr_backend> ocr = std::make_shared<tesseract_ocr_backend>(settings.ocr_pool_size);
+	if(options.char_classifier)
+		ocr = classifier = std::make_shared<char_classifier_backend>(ocr);
+
+	plate_recognizer recognizer(
+		std::vector<std::shared_ptr<base_plate_finder_strategy>> {
+			std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<plate_finder_by_rectangle>()),
+			std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<plate_finder_by_geometry>())
+		}, ocr, settings);
+
+	const auto total_frames = options.frame_count > 0 ? options.frame_count : frames.size();
+
+	std::atomic<size_t> next_frame{0};
+	std::mutex results_sync;
+	std::vector<double> latencies_ms;
+	latencies_ms.reserve(total_frames);
+	size_t labeled = 0, top_read_correct = 0, any_read_correct = 0, failed = 0;
+
+	const auto started = load_clock::now();
+	const auto worker = [&]
+	{
+		for(auto i = next_frame++; i < total_frames; i = next_frame++)
+		{
+			const auto& frame = frames[i % frames.size()];
+
+			//with a target frame rate, frame i is due at a fixed time after the start
+			//the latency is measured from that time and not from when a worker got to it, so a saturated recognizer shows up as latency
+			auto due = load_clock::now();
+			if(options.target_fps > 0)
+			{
+				due = started + std::chrono::duration_cast<load_clock::duration>(std::chrono::duration<double>(i / options.target_fps));
+				std::this_thread::sleep_until(due);
+			}
+
+			std::multimap<int, std::string, std::greater<int>> results;
+			auto succeeded = true;
+			try
+			{
+				recognizer.try_parse(frame.image, results);
+			}
+			catch(const std::exception& e)
+			{
+				succeeded = false;
+				std::cerr << frame.name << ": " << e.what() << std::endl;
+			}
+
+			const auto latency = std::chrono::duration<double, std::milli>(load_clock::now() - due).count();
+
+			std::lock_guard<std::mutex> lock(results_sync);
+			latencies_ms.push_back(latency);
+			if(!succeeded)
+				failed++;
+
+			if(frame.label.empty())
+				continue;
+
+			labeled++;
+			if(!results.empty() && results.begin()->second == frame.label)
+				top_read_correct++;
+			if(std::any_of(results.begin(), results.end(), [&](const std::pair<const int, std::string>& read) { return read.second == frame.label; }))
+				any_read_correct++;
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for(size_t i = 0; i < options.concurrency; i++)
+		workers.emplace_back(worker);
+	for(auto& thread : workers)
+		thread.join();
+
+	const auto wall_seconds = std::chrono::duration<double>(load_clock::now() - started).count();
+	std::sort(latencies_ms.begin(), latencies_ms.end());
+
+	const auto* metrics = recognizer.metrics();
+
+	json report;
+	report["frames"] = latencies_ms.size();
+	report["failed_frames"] = failed;
+	report["concurrency"] = options.concurrency;
+	report["target_fps"] = options.target_fps;
+	report["sustained_fps"] = wall_seconds > 0 ? latencies_ms.size() / wall_seconds : 0.0;
+	report["latency_ms"] = json {
+		{ "p50", percentile(latencies_ms, 0.50) },
+		{ "p90", percentile(latencies_ms, 0.90) },
+		{ "p99", percentile(latencies_ms, 0.99) },
+		{ "max", latencies_ms.empty() ? 0.0 : latencies_ms.back() }
+	};
+	report["ocr_calls_per_frame"] = latencies_ms.empty() ? 0.0 : static_cast<double>(metrics->ocr_call_count()) / latencies_ms.size();
+	report["accuracy"] = json {
+		{ "labeled_frames", labeled },
+		{ "top_read", labeled > 0 ? static_cast<double>(top_read_correct) / labeled : 0.0 },
+		{ "any_read", labeled > 0 ? static_cast<double>(any_read_correct) / labeled : 0.0 }
+	};
+	report["recognizer"] = metrics->to_json();
+	if(classifier != nullptr)
+		report["char_classifier"] = json {
+			{ "classified_reads", classifier->classified_count() },
+			{ "fallback_reads", classifier->fallback_count() }
+		};
+
+	if(options.output_path.empty())
+		std::cout << report.dump(2) << std::endl;
+	else
+		std::ofstream(options.output_path) << report.dump(2) << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,327 @@
+#define _USE_MATH_DEFINES
+#include <recognizer/plate_recognizer.h>
+#include <recognizer/plate_finder_by_geometry.hpp>
+#include "recognizer/plate_finder_by_rectangle.hpp"
+#include "recognizer/watchlist.hpp"
+#include "persister/plate_journal.h"
+#include "synthetic_plates.hpp"
+#include "bench_stats.hpp"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+//times every stage of the plate finder strategies (and the OCR) in isolation
+//the inputs are the test images and synthetic plates at several resolutions, the results are written as JSON,
+//so two runs (for example of two releases) can be compared by a script
+//usage: Raven.ANPR.Benchmarks [--iterations N] [--output results.json]
+
+using json = nlohmann::json;
+using bench_clock = std::chrono::steady_clock;
+
+struct bench_input
+{
+	std::string name;
+	cv::Mat image;
+};
+
+//all of the samples of a single stage on a single input
+struct stage_timings
+{
+	std::string stage;
+	std::string input;
+	std::vector<double> samples_us;
+
+	json to_json() const
+	{
+		auto sorted = samples_us;
+		std::sort(sorted.begin(), sorted.end());
+
+		double total = 0;
+		for(auto sample : samples_us)
+			total += sample;
+
+		return json {
+			{ "stage", stage },
+			{ "input", input },
+			{ "iterations", samples_us.size() },
+			{ "mean_us", total / samples_us.size() },
+			{ "min_us", *std::min_element(samples_us.begin(), samples_us.end()) },
+			{ "p50_us", percentile(sorted, 0.5) },
+			{ "p99_us", percentile(sorted, 0.99) }
+		};
+	}
+};
+
+//run 'action' 'iterations' times (after a single warm-up run), only the action is timed and not the setup
+template<typename TSetup, typename TAction>
+stage_timings measure(const std::string& stage, const std::string& input, const size_t iterations, TSetup&& setup, TAction&& action)
+{
+	setup();
+	action();
+
+	stage_timings timings { stage, input, {} };
+	timings.samples_us.reserve(iterations);
+	for(size_t i = 0; i < iterations; i++)
+	{
+		setup();
+		const auto started = bench_clock::now();
+		action();
+		timings.samples_us.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - started).count());
+	}
+
+	return timings;
+}
+
+std::vector<bench_input> load_inputs()
+{
+	std::vector<bench_input> inputs;
+
+	const std::vector<std::string> test_images {
+		"test_license_plate.jpg", "test_license_plate2.jpg", "test_license_plate3.jpg", "test_license_plate4.jpg",
+		"test_license_plate5.jpg", "test_license_plate6.jpg", "test_license_plate7.jpg", "test_license_plate8.jpg"
+	};
+
+	for(const auto& path : test_images)
+	{
+		auto image = cv::imread(path);
+		if(image.data == nullptr)
+		{
+			std::cerr << "skipping " << path << " (failed to load)" << std::endl;
+			continue;
+		}
+		inputs.push_back({ path, image });
+	}
+
+	//fixed seed, so every run benchmarks the same synthetic frames
+	std::mt19937 random(42);
+	const std::vector<cv::Size> resolutions { { 640, 480 }, { 1280, 720 }, { 1920, 1080 }, { 3840, 2160 } };
+	for(const auto& resolution : resolutions)
+	{
+		std::ostringstream name;
+		name << "synthetic_" << resolution.width << "x" << resolution.height;
+		inputs.push_back({ name.str(), make_synthetic_plate(resolution, "AB123CD", random) });
+	}
+
+	return inputs;
+}
+
+void benchmark_rectangle_strategy(const bench_input& input, const size_t iterations, std::vector<stage_timings>& results)
+{
+	plate_finder_by_rectangle finder;
+	frame_context frame;
+	contour_arena contours;
+
+	results.push_back(measure("rectangle.prepare_image_and_find_edges", input.name, iterations,
+		[&] { frame.reset(input.image); },
+		[&] { finder.prepare_image_and_find_edges(frame, contours); }));
+
+	std::vector<size_t> largest_contours;
+	results.push_back(measure("rectangle.get_largest_contours", input.name, iterations,
+		[] {},
+		[&] { plate_finder_by_rectangle::get_largest_contours(contours, largest_contours, 10); }));
+
+	//the crop needs a 4 corner contour, inputs where the strategy finds none don't get this stage
+	for(const auto contour_index : largest_contours)
+	{
+		cv::Mat approx_curve;
+		finder.get_encompassing_curve(contours[contour_index].as_mat(), approx_curve);
+		if(approx_curve.total() != 4)
+			continue;
+
+		cv::Mat cropped, mask;
+		results.push_back(measure("rectangle.crop_plate_candidate", input.name, iterations,
+			[] {},
+			[&] { finder.crop_plate_candidate(input.image, approx_curve, cropped, mask); }));
+		break;
+	}
+}
+
+void benchmark_geometry_strategy(const bench_input& input, const size_t iterations, std::vector<stage_timings>& results)
+{
+	plate_finder_by_geometry finder;
+	frame_context frame;
+	contour_arena contours;
+
+	results.push_back(measure("geometry.prepare_image_and_find_edges", input.name, iterations,
+		[&] { frame.reset(input.image); },
+		[&] { finder.prepare_image_and_find_edges(frame, contours); }));
+
+	//the contrast enhancement on its own, the fused kernel against the OpenCV chain it replaced
+	cv::Mat enhanced, enhanced_rows;
+	results.push_back(measure("geometry.contrast_kernel", input.name, iterations,
+		[] {},
+		[&] { contrast_kernel::apply(frame.detection_gray(), enhanced, enhanced_rows); }));
+
+	const auto kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+	cv::Mat top_hat, black_hat, sum;
+	results.push_back(measure("geometry.contrast_opencv", input.name, iterations,
+		[] {},
+		[&]
+		{
+			cv::morphologyEx(frame.detection_gray(), top_hat, cv::MORPH_TOPHAT, kernel);
+			cv::morphologyEx(frame.detection_gray(), black_hat, cv::MORPH_BLACKHAT, kernel);
+			cv::add(frame.detection_gray(), top_hat, sum);
+			cv::subtract(sum, black_hat, enhanced);
+		}));
+
+	std::vector<if_char> possible_chars;
+	results.push_back(measure("geometry.eliminate_irrelevant_contours_first_pass", input.name, iterations,
+		[&] { possible_chars.clear(); },
+		[&] { plate_finder_by_geometry::eliminate_irrelevant_contours_first_pass(contours, possible_chars); }));
+
+	std::vector<std::vector<size_t>> sequences;
+	results.push_back(measure("geometry.group_contours_to_sequences_second_pass", input.name, iterations,
+		[&] { sequences.clear(); },
+		[&] { plate_finder_by_geometry::group_contours_to_sequences_second_pass(possible_chars, sequences); }));
+
+	if(sequences.empty())
+		return;
+
+	const possible_plate plate(possible_chars, sequences.front());
+	cv::Mat cropped;
+	results.push_back(measure("geometry.crop_plate_candidate", input.name, iterations,
+		[] {},
+		[&] { plate_finder_by_geometry::crop_plate_candidate(input.image, plate, cropped); }));
+}
+
+void benchmark_ocr(plate_recognizer& recognizer, ocr_engine_pool& engines, const bench_input& input, const size_t iterations, std::vector<stage_timings>& results)
+{
+	std::vector<plate_candidate> candidates;
+	recognizer.find_plate_candidates(input.image, candidates);
+	if(candidates.empty())
+		return;
+
+	//one sample is the OCR of all of the candidates of the input, which is what try_parse() pays per frame
+	const auto engine = engines.acquire();
+	results.push_back(measure("ocr.try_execute_ocr", input.name, iterations,
+		[] {},
+		[&]
+		{
+			for(auto& candidate : candidates)
+			{
+				std::string text;
+				int confidence;
+				plate_recognizer::try_execute_ocr(*engine, candidate.image, text, confidence);
+			}
+		}));
+}
+
+void benchmark_watchlist(const size_t iterations, std::vector<stage_timings>& results)
+{
+	//a million random plates, and reads that are listed plates with a character dropped (so every lookup has to verify a hit)
+	std::mt19937 random(42);
+	const std::string alphabet = "ABCDEFGHJKMNPRTUVWXY0123456789";
+	std::uniform_int_distribution<size_t> character(0, alphabet.size() - 1);
+
+	std::vector<watchlist_entry> entries(1000000);
+	for(auto& entry : entries)
+		for(auto i = 0; i < 7; i++)
+			entry.number.push_back(alphabet[character(random)]);
+
+	std::vector<std::string> reads;
+	for(size_t i = 0; i < 1000; i++)
+		reads.push_back(entries[i * 997 % entries.size()].number.substr(1));
+
+	std::shared_ptr<const watchlist> list;
+	results.push_back(measure("watchlist.build", "1M_plates", 1,
+		[] {},
+		[&] { list = watchlist::build(entries); }));
+
+	//one sample is a thousand lookups
+	std::vector<watchlist_match> matches;
+	results.push_back(measure("watchlist.find_x1000", "1M_plates", iterations,
+		[] {},
+		[&]
+		{
+			for(const auto& read : reads)
+				list->find(read, matches);
+		}));
+}
+
+void benchmark_journal(const size_t iterations, std::vector<stage_timings>& results)
+{
+	const auto directory = (std::filesystem::temp_directory_path() / "raven_anpr_journal_benchmark").string();
+	std::filesystem::remove_all(directory);
+
+	//one sample is ten thousand appends with the default options, so it includes the batched flushes (and a segment rotation now and then)
+	{
+		plate_journal journal(directory);
+		const plate record { "AB123CD", std::time(nullptr) };
+		results.push_back(measure("journal.append_x10000", "default_options", iterations,
+			[] {},
+			[&]
+			{
+				for(auto i = 0; i < 10000; i++)
+					journal.append(record);
+			}));
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+}
+
+int main(int argc, char* argv[])
+{
+	size_t iterations = 20;
+	std::string output_path;
+
+	for(auto i = 1; i < argc; i++)
+	{
+		const std::string arg = argv[i];
+		if(arg == "--iterations" && i + 1 < argc)
+			iterations = std::max<size_t>(1, std::stoul(argv[++i]));
+		else if(arg == "--output" && i + 1 < argc)
+			output_path = argv[++i];
+		else
+		{
+			std::cerr << "usage: " << argv[0] << " [--iterations N] [--output results.json]" << std::endl;
+			return 1;
+		}
+	}
+
+	const auto inputs = load_inputs();
+
+	//only used to get the candidates for the OCR stage
+	recognizer_options options;
+	options.ocr_pool_size = 1;
+	plate_recognizer recognizer(
+		std::vector<std::shared_ptr<base_plate_finder_strategy>> {
+			std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<plate_finder_by_rectangle>()),
+			std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<plate_finder_by_geometry>())
+		}, options);
+	ocr_engine_pool engines(1);
+
+	std::vector<stage_timings> results;
+	for(const auto& input : inputs)
+	{
+		std::cerr << "benchmarking " << input.name << std::endl;
+		benchmark_rectangle_strategy(input, iterations, results);
+		benchmark_geometry_strategy(input, iterations, results);
+		benchmark_ocr(recognizer, engines, input, iterations, results);
+	}
+
+	std::cerr << "benchmarking the watchlist" << std::endl;
+	benchmark_watchlist(iterations, results);
+
+	std::cerr << "benchmarking the journal" << std::endl;
+	benchmark_journal(iterations, results);
+
+	json report;
+	report["iterations"] = iterations;
+	report["results"] = json::array();
+	for(const auto& timings : results)
+		report["results"].push_back(timings.to_json());
+
+	if(output_path.empty())
+		std::cout << report.dump(2) << std::endl;
+	else
+		std::ofstream(output_path) << report.dump(2) << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,17 @@
+#ifndef BENCH_STATS_HPP
+#define BENCH_STATS_HPP
+
+#include <cstddef>
+#include <vector>
+
+//nearest-rank percentile (p in 0-1) of samples sorted in ascending order, zero if there are none
+//shared by the stage benchmarks and the load generator, so their reports are comparable
+inline double percentile(const std::vector<double>& sorted_samples, const double p)
+{
+	if(sorted_samples.empty())
+		return 0;
+	const auto rank = static_cast<size_t>(p * (sorted_samples.size() - 1) + 0.5);
+	return sorted_samples[rank];
+}
+
+#endif // BENCH_STATS_HPP
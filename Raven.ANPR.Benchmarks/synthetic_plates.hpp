@@ -0,0 +1,46 @@
+#ifndef SYNTHETIC_PLATES_HPP
+#define SYNTHETIC_PLATES_HPP
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <random>
+#include <string>
+
+//a white plate with black characters on a noisy gray background, the plate takes about a quarter of the frame width
+inline cv::Mat make_synthetic_plate(const cv::Size& frame_size, const std::string& plate_number, std::mt19937& random)
+{
+	cv::Mat frame(frame_size, CV_8UC3);
+	cv::randn(frame, cv::Scalar(110, 110, 110), cv::Scalar(25, 25, 25));
+
+	const auto plate_width = frame_size.width / 4;
+	const auto plate_height = static_cast<int>(plate_width / 4.7);
+	std::uniform_int_distribution<int> x(0, frame_size.width - plate_width - 1);
+	std::uniform_int_distribution<int> y(0, frame_size.height - plate_height - 1);
+	const cv::Rect plate(x(random), y(random), plate_width, plate_height);
+
+	cv::rectangle(frame, plate, cv::Scalar(235, 235, 235), cv::FILLED);
+	cv::rectangle(frame, plate, cv::Scalar(20, 20, 20), std::max(2, plate_height / 20));
+
+	const auto font_scale = plate_height / 40.0;
+	const auto thickness = std::max(1, plate_height / 12);
+	int baseline = 0;
+	const auto text_size = cv::getTextSize(plate_number, cv::FONT_HERSHEY_SIMPLEX, font_scale, thickness, &baseline);
+	const cv::Point origin(plate.x + (plate.width - text_size.width) / 2, plate.y + (plate.height + text_size.height) / 2);
+	cv::putText(frame, plate_number, origin, cv::FONT_HERSHEY_SIMPLEX, font_scale, cv::Scalar(15, 15, 15), thickness);
+
+	return frame;
+}
+
+//random plate number in the AB123CD format
+inline std::string make_synthetic_plate_number(std::mt19937& random)
+{
+	std::uniform_int_distribution<int> letter('A', 'Z');
+	std::uniform_int_distribution<int> digit('0', '9');
+
+	std::string plate_number;
+	for(const auto kind : std::string("LLDDDLL"))
+		plate_number.push_back(static_cast<char>(kind == 'L' ? letter(random) : digit(random)));
+	return plate_number;
+}
+
+#endif // SYNTHETIC_PLATES_HPP
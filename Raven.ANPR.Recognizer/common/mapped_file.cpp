@@ -0,0 +1,108 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+mapped_file::mapped_file(const std::string& path)
+{
+	const auto file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return;
+	file_handle = file;
+
+	LARGE_INTEGER file_size;
+	if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		close();
+		return;
+	}
+
+	mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapping_handle == nullptr)
+	{
+		close();
+		return;
+	}
+
+	bytes = static_cast<const unsigned char*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+	if(bytes == nullptr)
+	{
+		close();
+		return;
+	}
+
+	length = static_cast<size_t>(file_size.QuadPart);
+}
+
+void mapped_file::close()
+{
+	if(bytes != nullptr)
+		UnmapViewOfFile(bytes);
+	if(mapping_handle != nullptr)
+		CloseHandle(mapping_handle);
+	if(file_handle != nullptr)
+		CloseHandle(file_handle);
+
+	bytes = nullptr;
+	length = 0;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+}
+
+#else
+
+mapped_file::mapped_file(const std::string& path)
+{
+	descriptor = ::open(path.c_str(), O_RDONLY);
+	if(descriptor < 0)
+		return;
+
+	struct stat file_stat {};
+	if(fstat(descriptor, &file_stat) != 0 || file_stat.st_size == 0)
+	{
+		close();
+		return;
+	}
+
+	const auto mapped = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	if(mapped == MAP_FAILED)
+	{
+		close();
+		return;
+	}
+
+	//the users (the image decoder, the journal replayer) read the file front to back
+	madvise(mapped, static_cast<size_t>(file_stat.st_size), MADV_SEQUENTIAL);
+
+	bytes = static_cast<const unsigned char*>(mapped);
+	length = static_cast<size_t>(file_stat.st_size);
+}
+
+void mapped_file::close()
+{
+	if(bytes != nullptr)
+		munmap(const_cast<unsigned char*>(bytes), length);
+	if(descriptor >= 0)
+		::close(descriptor);
+
+	bytes = nullptr;
+	length = 0;
+	descriptor = -1;
+}
+
+#endif
+
+mapped_file::~mapped_file()
+{
+	close();
+}
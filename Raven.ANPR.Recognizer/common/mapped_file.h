@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+//read-only memory mapping of a whole file, the pages are loaded by the OS as they are touched (no copy into a user buffer)
+//if the file can't be opened or mapped (or it is empty), is_open() is false - just like cv::imread() returns an empty image
+class mapped_file
+{
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#else
+	int descriptor = -1;
+#endif
+
+	void close();
+
+public:
+	explicit mapped_file(const std::string& path);
+
+	mapped_file(const mapped_file& other) = delete;
+	mapped_file& operator=(const mapped_file& other) = delete;
+
+	~mapped_file();
+
+	bool is_open() const { return bytes != nullptr; }
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+};
+
+#endif // MAPPED_FILE_H
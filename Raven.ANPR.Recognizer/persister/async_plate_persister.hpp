@@ -0,0 +1,270 @@
+#ifndef ASYNC_PLATE_PERSISTER_HPP
+#define ASYNC_PLATE_PERSISTER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "recognizer/bounded_queue.hpp"
+#include "plate_sink.hpp"
+
+//tuning knobs of async_plate_persister
+struct persister_options
+{
+	//reads waiting to be written, once it is full try_enqueue() drops reads (and enqueue() blocks)
+	size_t queue_capacity = 8192;
+
+	//a batch goes to the sink as soon as it has this many reads...
+	size_t max_batch_size = 512;
+
+	//...or when its first read has waited this long, whichever comes first
+	std::chrono::milliseconds max_batch_delay{250};
+
+	//how many times a batch is tried before its reads are given up on
+	size_t max_attempts = 3;
+
+	//wait before a retry, it grows linearly with the attempts
+	std::chrono::milliseconds retry_delay{100};
+};
+
+//counters of the persister, the backpressure ones tell whether the sink keeps up with recognition
+struct persister_stats
+{
+	size_t enqueued = 0;
+
+	//reads that did not fit into the full queue (or came after stop()) and were thrown away
+	size_t dropped = 0;
+
+	//enqueue() calls that had to wait for room in the queue
+	size_t blocked_pushes = 0;
+
+	size_t written = 0;
+
+	//reads of batches that failed on every attempt
+	size_t failed = 0;
+
+	size_t batches = 0;
+
+	//batches that were sent because they were full, the rest were sent because of max_batch_delay (or a shutdown)
+	size_t full_batches = 0;
+
+	//failed write_batch() calls, including the ones that succeeded on a retry later
+	size_t failed_attempts = 0;
+
+	size_t queue_depth = 0;
+	size_t queue_high_water_mark = 0;
+
+	//time spent in the sink (summed over all attempts)
+	std::chrono::nanoseconds sink_time{0};
+
+	double average_batch_size() const
+	{
+		return batches > 0 ? static_cast<double>(written + failed) / batches : 0.0;
+	}
+};
+
+//stores plate reads without making the recognition threads wait for the database
+//recognition threads put reads into a bounded queue, a single writer thread takes them out in batches and hands every batch
+//to the sink as one bulk write - so a slow round-trip costs one wait per batch instead of one per read, and never a recognition thread
+//once the queue is full, try_enqueue() drops the read instead of blocking - losing a few reads is better than stalling the cameras
+class async_plate_persister
+{
+private:
+	std::shared_ptr<plate_sink> sink;
+	persister_options options;
+	bounded_queue<plate> queue;
+
+	std::atomic<size_t> enqueued{0};
+	std::atomic<size_t> dropped{0};
+	std::atomic<size_t> blocked_pushes{0};
+	std::atomic<size_t> written{0};
+	std::atomic<size_t> failed{0};
+	std::atomic<size_t> batches{0};
+	std::atomic<size_t> full_batches{0};
+	std::atomic<size_t> failed_attempts{0};
+	std::atomic<size_t> high_water_mark{0};
+	std::atomic<long long> sink_nanoseconds{0};
+
+	//signaled whenever a batch is done, flush() waits on it
+	std::mutex progress_sync;
+	std::condition_variable progress;
+
+	std::thread writer;
+
+	void note_queue_depth()
+	{
+		const auto depth = queue.size();
+		auto current = high_water_mark.load();
+		while(depth > current && !high_water_mark.compare_exchange_weak(current, depth))
+		{
+		}
+	}
+
+	void write(const std::vector<plate>& batch)
+	{
+		for(size_t attempt = 1; ; attempt++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			auto succeeded = false;
+			try
+			{
+				sink->write_batch(batch);
+				succeeded = true;
+			}
+			catch(...)
+			{
+				//whatever went wrong, the writer thread has to keep going
+			}
+			sink_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+			if(succeeded)
+			{
+				written += batch.size();
+				break;
+			}
+
+			failed_attempts++;
+			if(attempt >= options.max_attempts)
+			{
+				failed += batch.size();
+				break;
+			}
+
+			std::this_thread::sleep_for(options.retry_delay * static_cast<long long>(attempt));
+		}
+
+		batches++;
+		if(batch.size() >= options.max_batch_size)
+			full_batches++;
+
+		{
+			std::lock_guard<std::mutex> lock(progress_sync);
+		}
+		progress.notify_all();
+	}
+
+	void run()
+	{
+		std::vector<plate> batch;
+		batch.reserve(options.max_batch_size);
+
+		plate read;
+		//the first read of a batch starts its clock, then the batch takes whatever comes until it is full or the time is up
+		//once the queue is closed and drained, pop() fails and the writer is done
+		while(queue.pop(read))
+		{
+			batch.push_back(std::move(read));
+			const auto deadline = std::chrono::steady_clock::now() + options.max_batch_delay;
+
+			while(batch.size() < options.max_batch_size)
+			{
+				const auto remaining = deadline - std::chrono::steady_clock::now();
+				if(remaining <= std::chrono::steady_clock::duration::zero() || !queue.pop_for(read, remaining))
+					break;
+				batch.push_back(std::move(read));
+			}
+
+			write(batch);
+			batch.clear();
+		}
+	}
+
+public:
+	explicit async_plate_persister(std::shared_ptr<plate_sink> sink, const persister_options& options = persister_options())
+		: sink(std::move(sink)),
+		  options(options),
+		  queue(options.queue_capacity)
+	{
+		if(this->sink == nullptr)
+			throw std::invalid_argument("async_plate_persister needs a sink to write to");
+
+		if(this->options.max_batch_size == 0)
+			this->options.max_batch_size = 1;
+		if(this->options.max_attempts == 0)
+			this->options.max_attempts = 1;
+
+		writer = std::thread([this] { run(); });
+	}
+
+	async_plate_persister(const async_plate_persister& other) = delete;
+	async_plate_persister& operator=(const async_plate_persister& other) = delete;
+
+	//whatever is still queued is written before the persister goes away
+	~async_plate_persister()
+	{
+		stop();
+	}
+
+	//never blocks, false if the read was dropped because the queue is full (or the persister is stopped)
+	bool try_enqueue(plate read)
+	{
+		if(!queue.try_push(std::move(read)))
+		{
+			dropped++;
+			return false;
+		}
+
+		enqueued++;
+		note_queue_depth();
+		return true;
+	}
+
+	//blocks while the queue is full, for callers that would rather wait than lose reads
+	//false only if the persister is stopped
+	bool enqueue(plate read)
+	{
+		if(!queue.try_push(read))
+		{
+			blocked_pushes++;
+			if(!queue.push(std::move(read)))
+			{
+				dropped++;
+				return false;
+			}
+		}
+
+		enqueued++;
+		note_queue_depth();
+		return true;
+	}
+
+	//wait until every read enqueued before this call has been written (or given up on)
+	//a partial batch is sent only when its delay is up, so this may take up to max_batch_delay on top of the write itself
+	void flush()
+	{
+		const size_t target = enqueued;
+		std::unique_lock<std::mutex> lock(progress_sync);
+		progress.wait(lock, [this, target] { return written + failed >= target; });
+	}
+
+	//stop taking reads, write out what is queued and wait for the writer thread to finish
+	void stop()
+	{
+		queue.close();
+		if(writer.joinable())
+			writer.join();
+	}
+
+	persister_stats statistics() const
+	{
+		persister_stats stats;
+		stats.enqueued = enqueued;
+		stats.dropped = dropped;
+		stats.blocked_pushes = blocked_pushes;
+		stats.written = written;
+		stats.failed = failed;
+		stats.batches = batches;
+		stats.full_batches = full_batches;
+		stats.failed_attempts = failed_attempts;
+		stats.queue_depth = queue.size();
+		stats.queue_high_water_mark = high_water_mark;
+		stats.sink_time = std::chrono::nanoseconds(sink_nanoseconds.load());
+		return stats;
+	}
+};
+
+#endif // ASYNC_PLATE_PERSISTER_HPP
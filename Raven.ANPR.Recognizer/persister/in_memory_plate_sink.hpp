@@ -0,0 +1,54 @@
+#ifndef IN_MEMORY_PLATE_SINK_HPP
+#define IN_MEMORY_PLATE_SINK_HPP
+
+#include <mutex>
+#include <stdexcept>
+#include "plate_sink.hpp"
+
+//in-process stand-in for the database, it keeps the batches it was given, in order
+//mostly for tests - it can also be told to fail the next few writes, to see what the persister does about it
+class in_memory_plate_sink final : public plate_sink
+{
+private:
+	std::vector<std::vector<plate>> stored_batches;
+	size_t writes_to_fail = 0;
+	mutable std::mutex sync;
+
+public:
+	void write_batch(const std::vector<plate>& batch) override
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		if(writes_to_fail > 0)
+		{
+			writes_to_fail--;
+			throw std::runtime_error("Simulated failure of the in-memory plate sink");
+		}
+
+		stored_batches.push_back(batch);
+	}
+
+	//the next 'count' calls of write_batch() throw
+	void fail_next_writes(const size_t count)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		writes_to_fail = count;
+	}
+
+	//copies, so the persister can keep writing while the caller looks at them
+	std::vector<std::vector<plate>> batches() const
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		return stored_batches;
+	}
+
+	std::vector<plate> plates() const
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		std::vector<plate> all;
+		for(const auto& batch : stored_batches)
+			all.insert(all.end(), batch.begin(), batch.end());
+		return all;
+	}
+};
+
+#endif // IN_MEMORY_PLATE_SINK_HPP
@@ -0,0 +1,46 @@
+#ifndef JOURNALED_PLATE_SINK_HPP
+#define JOURNALED_PLATE_SINK_HPP
+
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include "plate_sink.hpp"
+#include "plate_journal.h"
+
+//sink in front of the database sink: batches the database can't take go into the local journal instead of being lost
+//(a plate_journal_replayer moves them to the database once it is back)
+//the persister never sees a failure through this sink, so it doesn't hold up the queue retrying a database that is down
+class journaled_plate_sink final : public plate_sink
+{
+private:
+	std::shared_ptr<plate_sink> primary;
+	std::shared_ptr<plate_journal> journal;
+	std::atomic<size_t> journaled_records{0};
+
+public:
+	journaled_plate_sink(std::shared_ptr<plate_sink> primary, std::shared_ptr<plate_journal> journal)
+		: primary(std::move(primary)),
+		  journal(std::move(journal))
+	{
+		if(this->primary == nullptr || this->journal == nullptr)
+			throw std::invalid_argument("journaled_plate_sink needs both a sink and a journal");
+	}
+
+	void write_batch(const std::vector<plate>& batch) override
+	{
+		try
+		{
+			primary->write_batch(batch);
+		}
+		catch(...)
+		{
+			journal->append(batch);
+			journaled_records += batch.size();
+		}
+	}
+
+	//records that went to the journal instead of the primary sink
+	size_t journaled_count() const { return journaled_records; }
+};
+
+#endif // JOURNALED_PLATE_SINK_HPP
@@ -0,0 +1,259 @@
+#include "plate_journal.h"
+#include "plate_journal_format.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char segment_prefix[] = "plates-";
+	const char segment_extension[] = ".journal";
+}
+
+std::string plate_journal::segment_file_name(const uint64_t segment_sequence)
+{
+	char name[64];
+	std::snprintf(name, sizeof(name), "%s%016llu%s", segment_prefix, static_cast<unsigned long long>(segment_sequence), segment_extension);
+	return name;
+}
+
+std::vector<uint64_t> plate_journal::list_segments(const std::string& directory)
+{
+	std::vector<uint64_t> sequences;
+	std::error_code error;
+	for(const auto& entry : std::filesystem::directory_iterator(directory, error))
+	{
+		const auto name = entry.path().filename().string();
+		const auto prefix_length = sizeof(segment_prefix) - 1;
+		const auto extension_length = sizeof(segment_extension) - 1;
+		if(name.size() <= prefix_length + extension_length ||
+			name.compare(0, prefix_length, segment_prefix) != 0 ||
+			name.compare(name.size() - extension_length, extension_length, segment_extension) != 0)
+			continue;
+
+		const auto digits = name.substr(prefix_length, name.size() - prefix_length - extension_length);
+		if(!std::all_of(digits.begin(), digits.end(), [](const char c) { return c >= '0' && c <= '9'; }))
+			continue;
+
+		sequences.push_back(std::stoull(digits));
+	}
+
+	std::sort(sequences.begin(), sequences.end());
+	return sequences;
+}
+
+plate_journal::plate_journal(const std::string& directory, const journal_options& options)
+	: directory(directory),
+	  options(options)
+{
+	//a segment has to take at least a few records, whatever the options say
+	this->options.segment_size = std::max<size_t>(this->options.segment_size, 4096);
+	this->options.sync_every_records = std::max<size_t>(this->options.sync_every_records, 1);
+
+	std::filesystem::create_directories(directory);
+
+	//never append to a segment of an earlier run, its tail may be torn
+	const auto existing = list_segments(directory);
+	open_segment(existing.empty() ? 1 : existing.back() + 1);
+}
+
+plate_journal::~plate_journal()
+{
+	std::lock_guard<std::mutex> lock(sync);
+	close_segment();
+}
+
+void plate_journal::append(const plate& record)
+{
+	std::lock_guard<std::mutex> lock(sync);
+	append_locked(record);
+}
+
+void plate_journal::append(const std::vector<plate>& records)
+{
+	std::lock_guard<std::mutex> lock(sync);
+	for(const auto& record : records)
+		append_locked(record);
+}
+
+void plate_journal::append_locked(const plate& record)
+{
+	const auto size = plate_journal_format::encoded_size(record);
+	if(write_offset + size > capacity)
+	{
+		close_segment();
+		open_segment(sequence + 1);
+	}
+
+	plate_journal_format::encode(record, data + write_offset);
+	write_offset += size;
+
+	if(unsynced_records++ == 0)
+		first_unsynced_time = std::chrono::steady_clock::now();
+
+	if(unsynced_records >= options.sync_every_records ||
+		(options.sync_interval.count() > 0 && std::chrono::steady_clock::now() - first_unsynced_time >= options.sync_interval))
+		sync_locked();
+}
+
+void plate_journal::flush()
+{
+	std::lock_guard<std::mutex> lock(sync);
+	sync_locked();
+}
+
+void plate_journal::rotate()
+{
+	std::lock_guard<std::mutex> lock(sync);
+	close_segment();
+	open_segment(sequence + 1);
+}
+
+uint64_t plate_journal::active_sequence()
+{
+	std::lock_guard<std::mutex> lock(sync);
+	return sequence;
+}
+
+#ifdef _WIN32
+
+void plate_journal::open_segment(const uint64_t segment_sequence)
+{
+	const auto path = (std::filesystem::path(directory) / segment_file_name(segment_sequence)).string();
+	const auto file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to create the journal segment " + path);
+
+	//mapping more than the file has grows the file to the mapped size (zero filled)
+	const auto size = static_cast<unsigned long long>(options.segment_size);
+	const auto mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size & 0xFFFFFFFF), nullptr);
+	if(mapping == nullptr)
+	{
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map the journal segment " + path);
+	}
+
+	const auto view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, options.segment_size);
+	if(view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Failed to map the journal segment " + path);
+	}
+
+	file_handle = file;
+	mapping_handle = mapping;
+	data = static_cast<unsigned char*>(view);
+	capacity = options.segment_size;
+	sequence = segment_sequence;
+
+	plate_journal_format::write_segment_header(data, sequence);
+	write_offset = plate_journal_format::segment_header_size;
+	synced_offset = 0;
+	unsynced_records = 0;
+}
+
+void plate_journal::sync_locked()
+{
+	if(data == nullptr || write_offset == synced_offset)
+		return;
+
+	FlushViewOfFile(data + synced_offset, write_offset - synced_offset);
+	FlushFileBuffers(file_handle);
+	synced_offset = write_offset;
+	unsynced_records = 0;
+}
+
+void plate_journal::close_segment()
+{
+	if(data == nullptr)
+		return;
+
+	sync_locked();
+	UnmapViewOfFile(data);
+	CloseHandle(mapping_handle);
+
+	LARGE_INTEGER end;
+	end.QuadPart = static_cast<LONGLONG>(write_offset);
+	if(SetFilePointerEx(file_handle, end, nullptr, FILE_BEGIN))
+		SetEndOfFile(file_handle);
+	CloseHandle(file_handle);
+
+	data = nullptr;
+	mapping_handle = nullptr;
+	file_handle = nullptr;
+}
+
+#else
+
+void plate_journal::open_segment(const uint64_t segment_sequence)
+{
+	const auto path = (std::filesystem::path(directory) / segment_file_name(segment_sequence)).string();
+	const auto file = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(file < 0)
+		throw std::runtime_error("Failed to create the journal segment " + path);
+
+	if(ftruncate(file, static_cast<off_t>(options.segment_size)) != 0)
+	{
+		::close(file);
+		throw std::runtime_error("Failed to allocate the journal segment " + path);
+	}
+
+	const auto mapped = mmap(nullptr, options.segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if(mapped == MAP_FAILED)
+	{
+		::close(file);
+		throw std::runtime_error("Failed to map the journal segment " + path);
+	}
+
+	descriptor = file;
+	data = static_cast<unsigned char*>(mapped);
+	capacity = options.segment_size;
+	sequence = segment_sequence;
+
+	plate_journal_format::write_segment_header(data, sequence);
+	write_offset = plate_journal_format::segment_header_size;
+	synced_offset = 0;
+	unsynced_records = 0;
+}
+
+void plate_journal::sync_locked()
+{
+	if(data == nullptr || write_offset == synced_offset)
+		return;
+
+	//msync() wants a page aligned start
+	static const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	const auto start = synced_offset - synced_offset % page_size;
+	msync(data + start, write_offset - start, MS_SYNC);
+	synced_offset = write_offset;
+	unsynced_records = 0;
+}
+
+void plate_journal::close_segment()
+{
+	if(data == nullptr)
+		return;
+
+	sync_locked();
+	munmap(data, capacity);
+	if(ftruncate(descriptor, static_cast<off_t>(write_offset)) == 0)
+		fsync(descriptor);
+	::close(descriptor);
+
+	data = nullptr;
+	descriptor = -1;
+}
+
+#endif
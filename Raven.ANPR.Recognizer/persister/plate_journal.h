@@ -0,0 +1,94 @@
+#ifndef PLATE_JOURNAL_H
+#define PLATE_JOURNAL_H
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "plate_record.hpp"
+
+//tuning knobs of plate_journal
+struct journal_options
+{
+	//size of a segment file, it is allocated in full when the segment is started
+	size_t segment_size = 16 * 1024 * 1024;
+
+	//the written records are flushed to the disk once this many of them are waiting...
+	size_t sync_every_records = 1024;
+
+	//...or once the oldest of them has waited this long (checked on the next append), zero means only the record count matters
+	std::chrono::milliseconds sync_interval{200};
+};
+
+//append-only local journal of plate records, for when the database can't take them
+//the records go into memory mapped segment files (see plate_journal_format.hpp), so an append is a memcpy and a CRC -
+//no system call and no allocation, the cost of one is dominated by the mutex
+//what is written to the mapping survives a crash of the process right away (the pages belong to the OS), flushing them to
+//the disk (which is what protects against a power loss) is batched, once per 'sync_every_records' records or 'sync_interval'
+//the journal always writes into a new segment after it is opened, the segments of earlier runs (and those it rotated away from)
+//are sealed and can be drained into the database with plate_journal_replayer
+//note: thread-safe, any number of threads can append at the same time
+class plate_journal
+{
+private:
+	std::string directory;
+	journal_options options;
+
+	//the segment that is being written
+	uint64_t sequence = 0;
+	unsigned char* data = nullptr;
+	size_t capacity = 0;
+	size_t write_offset = 0;
+	size_t synced_offset = 0;
+	size_t unsynced_records = 0;
+	std::chrono::steady_clock::time_point first_unsynced_time;
+
+#ifdef _WIN32
+	void* file_handle = nullptr;
+	void* mapping_handle = nullptr;
+#else
+	int descriptor = -1;
+#endif
+
+	std::mutex sync;
+
+	void open_segment(uint64_t segment_sequence);
+
+	//unmap the segment, cutting the file down to the records it has
+	void close_segment();
+
+	void sync_locked();
+	void append_locked(const plate& record);
+
+public:
+	//the directory is created if it doesn't exist
+	explicit plate_journal(const std::string& directory, const journal_options& options = journal_options());
+
+	plate_journal(const plate_journal& other) = delete;
+	plate_journal& operator=(const plate_journal& other) = delete;
+
+	~plate_journal();
+
+	void append(const plate& record);
+
+	//the whole batch under a single lock
+	void append(const std::vector<plate>& records);
+
+	//flush whatever was appended to the disk now
+	void flush();
+
+	//seal the current segment and continue in a new one, so a replayer can drain everything appended so far
+	void rotate();
+
+	//sequence number of the segment being written, the segments before it are sealed
+	uint64_t active_sequence();
+
+	//file name of the segment with the given sequence number
+	static std::string segment_file_name(uint64_t segment_sequence);
+
+	//sequence numbers of the segments in the directory, oldest first
+	static std::vector<uint64_t> list_segments(const std::string& directory);
+};
+
+#endif // PLATE_JOURNAL_H
@@ -0,0 +1,178 @@
+#ifndef PLATE_JOURNAL_FORMAT_HPP
+#define PLATE_JOURNAL_FORMAT_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include "plate_record.hpp"
+
+//binary layout of the plate journal segments, shared by the writer (plate_journal) and the reader (plate_journal_replayer)
+//
+//a segment starts with a header: magic "RPJ1", format version and the sequence number of the segment (u32, u32, u64)
+//then come the records, one after another:
+//	u32 payload size, u32 CRC-32 of the payload,
+//	payload = i64 when_taken, i64 last_seen, i32 confidence, u32 reads, u16 length of the number, the number's characters
+//all of the integers are little endian
+//segment files are created at their full size, so they are zero filled after the last record - a zero payload size is the end
+//the payload is written before its size and CRC, a record torn by a crash has a zero size or a bad CRC, and ends the segment
+struct plate_journal_format
+{
+	static constexpr uint32_t magic = 0x314A5052; // "RPJ1"
+	static constexpr uint32_t version = 2;
+	static constexpr size_t segment_header_size = 16;
+	static constexpr size_t record_header_size = 8;
+
+	//the payload before the number's characters
+	static constexpr size_t fixed_payload_size = 8 + 8 + 4 + 4 + 2;
+
+	//plate numbers longer than this are cut, nothing on a real plate comes close
+	static constexpr size_t max_number_length = 255;
+
+	enum class read_result
+	{
+		record,
+		end,
+		corrupted
+	};
+
+	static uint32_t crc32(const unsigned char* data, const size_t size)
+	{
+		static const auto table = []
+		{
+			std::array<uint32_t, 256> values {};
+			for(uint32_t i = 0; i < 256; i++)
+			{
+				auto c = i;
+				for(auto bit = 0; bit < 8; bit++)
+					c = (c & 1) != 0 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				values[i] = c;
+			}
+			return values;
+		}();
+
+		auto crc = 0xFFFFFFFFu;
+		for(size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return crc ^ 0xFFFFFFFFu;
+	}
+
+	static void write_u16(unsigned char* out, const uint16_t value)
+	{
+		out[0] = static_cast<unsigned char>(value);
+		out[1] = static_cast<unsigned char>(value >> 8);
+	}
+
+	static void write_u32(unsigned char* out, const uint32_t value)
+	{
+		for(auto i = 0; i < 4; i++)
+			out[i] = static_cast<unsigned char>(value >> (8 * i));
+	}
+
+	static void write_u64(unsigned char* out, const uint64_t value)
+	{
+		for(auto i = 0; i < 8; i++)
+			out[i] = static_cast<unsigned char>(value >> (8 * i));
+	}
+
+	static uint16_t read_u16(const unsigned char* in)
+	{
+		return static_cast<uint16_t>(in[0] | in[1] << 8);
+	}
+
+	static uint32_t read_u32(const unsigned char* in)
+	{
+		uint32_t value = 0;
+		for(auto i = 0; i < 4; i++)
+			value |= static_cast<uint32_t>(in[i]) << (8 * i);
+		return value;
+	}
+
+	static uint64_t read_u64(const unsigned char* in)
+	{
+		uint64_t value = 0;
+		for(auto i = 0; i < 8; i++)
+			value |= static_cast<uint64_t>(in[i]) << (8 * i);
+		return value;
+	}
+
+	static size_t number_length(const plate& record)
+	{
+		return std::min(record.number.size(), max_number_length);
+	}
+
+	//bytes the record takes in a segment, header included
+	static size_t encoded_size(const plate& record)
+	{
+		return record_header_size + fixed_payload_size + number_length(record);
+	}
+
+	static void write_segment_header(unsigned char* out, const uint64_t sequence)
+	{
+		write_u32(out, magic);
+		write_u32(out + 4, version);
+		write_u64(out + 8, sequence);
+	}
+
+	//false if this is not a segment of a journal (or of a version this code doesn't know)
+	static bool read_segment_header(const unsigned char* in, const size_t size, uint64_t& sequence)
+	{
+		if(size < segment_header_size || read_u32(in) != magic || read_u32(in + 4) != version)
+			return false;
+
+		sequence = read_u64(in + 8);
+		return true;
+	}
+
+	//'out' must have encoded_size(record) bytes, the header goes last (see above)
+	static void encode(const plate& record, unsigned char* out)
+	{
+		const auto length = number_length(record);
+		auto* payload = out + record_header_size;
+		write_u64(payload, static_cast<uint64_t>(static_cast<int64_t>(record.when_taken)));
+		write_u64(payload + 8, static_cast<uint64_t>(static_cast<int64_t>(record.last_seen)));
+		write_u32(payload + 16, static_cast<uint32_t>(static_cast<int32_t>(record.confidence)));
+		write_u32(payload + 20, static_cast<uint32_t>(std::min<size_t>(record.reads, std::numeric_limits<uint32_t>::max())));
+		write_u16(payload + 24, static_cast<uint16_t>(length));
+		std::memcpy(payload + fixed_payload_size, record.number.data(), length);
+
+		const auto payload_size = static_cast<uint32_t>(fixed_payload_size + length);
+		write_u32(out + 4, crc32(payload, payload_size));
+
+		//the size makes the record visible, it must not land in memory before the rest of the record
+		std::atomic_thread_fence(std::memory_order_release);
+		write_u32(out, payload_size);
+	}
+
+	//read the record at 'offset' and move past it
+	static read_result decode(const unsigned char* data, const size_t size, size_t& offset, plate& record)
+	{
+		if(offset + record_header_size > size)
+			return read_result::end;
+
+		const auto payload_size = read_u32(data + offset);
+		if(payload_size == 0)
+			return read_result::end;
+
+		const auto* payload = data + offset + record_header_size;
+		if(payload_size < fixed_payload_size || payload_size > size - offset - record_header_size ||
+			crc32(payload, payload_size) != read_u32(data + offset + 4))
+			return read_result::corrupted;
+
+		const auto length = read_u16(payload + 24);
+		if(fixed_payload_size + length != payload_size)
+			return read_result::corrupted;
+
+		record.when_taken = static_cast<std::time_t>(static_cast<int64_t>(read_u64(payload)));
+		record.last_seen = static_cast<std::time_t>(static_cast<int64_t>(read_u64(payload + 8)));
+		record.confidence = static_cast<int32_t>(read_u32(payload + 16));
+		record.reads = read_u32(payload + 20);
+		record.number.assign(reinterpret_cast<const char*>(payload + fixed_payload_size), length);
+		offset += record_header_size + payload_size;
+		return read_result::record;
+	}
+};
+
+#endif // PLATE_JOURNAL_FORMAT_HPP
@@ -0,0 +1,99 @@
+#include "plate_journal_replayer.h"
+#include "plate_journal.h"
+#include "plate_journal_format.hpp"
+#include "common/mapped_file.h"
+#include <algorithm>
+#include <filesystem>
+
+plate_journal_replayer::plate_journal_replayer(std::string directory, const size_t batch_size)
+	: directory(std::move(directory)),
+	  batch_size(std::max<size_t>(batch_size, 1))
+{
+}
+
+plate_journal_replayer::segment_result plate_journal_replayer::replay_segment(const std::string& path, plate_sink& sink, journal_replay_stats& stats) const
+{
+	const mapped_file segment(path);
+
+	if(!segment.is_open())
+	{
+		//an empty file is a segment that was created but never got its header (a crash right at the start), there is nothing in it
+		//anything else (no permission, out of file descriptors, a sharing violation, ...) may well go away, the segment has to stay
+		std::error_code error;
+		const auto size = std::filesystem::file_size(path, error);
+		return !error && size == 0 ? segment_result::replayed : segment_result::failed;
+	}
+
+	uint64_t sequence;
+
+	if(!plate_journal_format::read_segment_header(segment.data(), segment.size(), sequence))
+		return segment_result::corrupted;
+
+	std::vector<plate> batch;
+	batch.reserve(batch_size);
+
+	plate record;
+	size_t offset = plate_journal_format::segment_header_size;
+	while(true)
+	{
+		const auto result = plate_journal_format::decode(segment.data(), segment.size(), offset, record);
+		if(result == plate_journal_format::read_result::record)
+		{
+			batch.push_back(record);
+			if(batch.size() < batch_size)
+				continue;
+		}
+
+		if(!batch.empty())
+		{
+			try
+			{
+				sink.write_batch(batch);
+			}
+			catch(...)
+			{
+				return segment_result::failed;
+			}
+
+			stats.records += batch.size();
+			batch.clear();
+		}
+
+		if(result == plate_journal_format::read_result::corrupted)
+			return segment_result::corrupted;
+		if(result == plate_journal_format::read_result::end)
+			return segment_result::replayed;
+	}
+}
+
+journal_replay_stats plate_journal_replayer::replay(plate_sink& sink, const uint64_t end_sequence) const
+{
+	journal_replay_stats stats;
+	for(const auto sequence : plate_journal::list_segments(directory))
+	{
+		if(sequence >= end_sequence)
+			break;
+
+		const auto path = (std::filesystem::path(directory) / plate_journal::segment_file_name(sequence)).string();
+		const auto result = replay_segment(path, sink, stats);
+		if(result == segment_result::failed)
+		{
+			stats.completed = false;
+			break;
+		}
+
+		//the mapping is closed by now (Windows won't delete or rename a mapped file)
+		//a damaged segment no longer matches the segment names, so it isn't replayed (and its records duplicated) again
+		std::error_code error;
+		if(result == segment_result::corrupted)
+		{
+			stats.corrupted_segments++;
+			std::filesystem::rename(path, path + ".corrupt", error);
+		}
+		else
+			std::filesystem::remove(path, error);
+		stats.segments++;
+	}
+
+	return stats;
+}
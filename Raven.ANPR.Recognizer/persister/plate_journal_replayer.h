@@ -0,0 +1,56 @@
+#ifndef PLATE_JOURNAL_REPLAYER_H
+#define PLATE_JOURNAL_REPLAYER_H
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include "plate_sink.hpp"
+
+//what a single plate_journal_replayer::replay() call did
+struct journal_replay_stats
+{
+	size_t segments = 0;
+	size_t records = 0;
+
+	//segments with a torn or damaged record, the records before it are replayed and the segment is set aside
+	//(renamed to *.corrupt, see plate_journal_replayer) instead of being deleted
+	size_t corrupted_segments = 0;
+
+	//false if the sink failed (or a segment could not be read), the segment it failed on (and everything after it) is still in the journal
+	bool completed = true;
+};
+
+//drains the sealed segments of a plate_journal into a sink (the database), once it is reachable again
+//a segment is deleted only after all of its records are in the sink - if the sink fails half way through a segment, the whole
+//segment is replayed the next time, so the sink may get some records twice (at-least-once, never lost)
+//a damaged segment is never deleted: the records before the damage go to the sink, and the file is renamed to
+//<segment>.corrupt, so it is skipped from then on but the rest of it can still be looked at (or recovered by hand)
+class plate_journal_replayer
+{
+private:
+	std::string directory;
+	size_t batch_size;
+
+	enum class segment_result
+	{
+		//all of the records are in the sink, the segment can go
+		replayed,
+
+		//the records up to the damage are in the sink, the segment has to be kept aside
+		corrupted,
+
+		//the sink threw or the segment could not be read, the segment has to stay for the next replay
+		failed
+	};
+
+	segment_result replay_segment(const std::string& path, plate_sink& sink, journal_replay_stats& stats) const;
+
+public:
+	explicit plate_journal_replayer(std::string directory, size_t batch_size = 512);
+
+	//replay the segments with a sequence number below 'end_sequence', oldest first, in batches of 'batch_size'
+	//pass plate_journal::active_sequence() while the journal is being written, the active segment must not be replayed
+	journal_replay_stats replay(plate_sink& sink, uint64_t end_sequence = std::numeric_limits<uint64_t>::max()) const;
+};
+
+#endif // PLATE_JOURNAL_REPLAYER_H
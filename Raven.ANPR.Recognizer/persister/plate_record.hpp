@@ -1,5 +1,6 @@
 #ifndef PLATE_HPP
 #define PLATE_HPP
+#include <cstddef>
 #include <string>
 #include <ctime>
 #include <chrono>
@@ -11,17 +12,26 @@ struct plate
 {
 	std::string number;
 	std::time_t when_taken;
+
+	//a record can stand for a whole sighting (see sighting_index) - its last read, best confidence and the number of reads
+	//a single read leaves last_seen at zero
+	std::time_t last_seen = 0;
+	int confidence = 0;
+	size_t reads = 1;
 };
 
 namespace ns
 {
 	inline void to_json(json& j, const plate& p) {
-        j = json{{"number", p.number}, {"when_taken", p.when_taken}};
+        j = json{{"number", p.number}, {"when_taken", p.when_taken}, {"last_seen", p.last_seen}, {"confidence", p.confidence}, {"reads", p.reads}};
     }
 
 	inline void from_json(const json& j, plate& p) {
         j.at("number").get_to(p.number);
         j.at("when_taken").get_to(p.when_taken);
+        p.last_seen = j.value("last_seen", std::time_t(0));
+        p.confidence = j.value("confidence", 0);
+        p.reads = j.value("reads", size_t(1));
     }
 }
 
@@ -0,0 +1,19 @@
+#ifndef PLATE_SINK_HPP
+#define PLATE_SINK_HPP
+
+#include <vector>
+#include "plate_record.hpp"
+
+//where async_plate_persister stores its batches - a bulk insert into the database, a file, or just memory for tests
+//note: write_batch() is called by the single writer thread of the persister, so a sink doesn't need to be thread-safe for it
+class plate_sink
+{
+public:
+	virtual ~plate_sink() = default;
+
+	//store the whole batch in one go (one round-trip, if there is a network in between)
+	//throws if the batch could not be stored, the persister retries it then
+	virtual void write_batch(const std::vector<plate>& batch) = 0;
+};
+
+#endif // PLATE_SINK_HPP
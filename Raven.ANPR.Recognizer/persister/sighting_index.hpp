@@ -0,0 +1,234 @@
+#ifndef SIGHTING_INDEX_HPP
+#define SIGHTING_INDEX_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "plate_record.hpp"
+
+//one car seen by the cameras, all of its reads rolled into one
+struct sighting
+{
+	//normalized (see sighting_index::normalize())
+	std::string number;
+
+	std::time_t first_seen = 0;
+	std::time_t last_seen = 0;
+	int best_confidence = 0;
+	size_t reads = 0;
+
+	//what goes to the database for it, all of it - when it was seen last, how well and how often
+	plate record() const { return plate { number, first_seen, last_seen, best_confidence, reads }; }
+};
+
+//tuning knobs of sighting_index
+struct sighting_options
+{
+	//a read of the same plate within this time of its sighting (after its last read, or before its first one) belongs to it
+	std::chrono::seconds window{30};
+};
+
+//counters of the sighting index, reads / closed sightings is how much less the database has to write
+struct sighting_stats
+{
+	size_t reads = 0;
+	size_t sightings_opened = 0;
+	size_t sightings_closed = 0;
+	size_t open_sightings = 0;
+};
+
+//recent sightings keyed by the normalized plate number, to collapse the reads of the same car into one record
+//a car stays in frame for many frames and often passes several cameras, every one of those reads comes here and only
+//extends its sighting - the sighting is closed (and goes to the database) once its plate has not been read for a whole window
+//lookups are a single hash probe, sightings are closed through a heap ordered by their last read, so nothing ever scans the index
+//a plate can have more than one open sighting (it came back after a gap, or a camera sends reads from before one), so each number
+//has a short list of them - late reads join the one whose window they fall into instead of opening one of their own
+//note: thread-safe, the cameras can share one index
+class sighting_index
+{
+private:
+	sighting_options options;
+
+	//sightings live in slots that are reused, a slot's generation tells whether a heap entry still refers to its sighting
+	std::vector<sighting> slots;
+	std::vector<uint32_t> generations;
+	std::vector<size_t> free_slots;
+
+	//open sightings of each number, ordered by their first read - the last one is the current sighting of the plate
+	std::unordered_map<std::string, std::vector<size_t>> slots_by_number;
+
+	//(last read, slot, generation) for every read, the entries of sightings read again since are skipped when they come up
+	struct expiry
+	{
+		std::time_t last_seen;
+		size_t slot;
+		uint32_t generation;
+
+		bool operator>(const expiry& other) const { return last_seen > other.last_seen; }
+	};
+	std::priority_queue<expiry, std::vector<expiry>, std::greater<expiry>> expiries;
+
+	sighting_stats stats;
+	std::string normalized;
+	mutable std::mutex sync;
+
+	size_t take_slot()
+	{
+		if(!free_slots.empty())
+		{
+			const auto slot = free_slots.back();
+			free_slots.pop_back();
+			return slot;
+		}
+
+		slots.emplace_back();
+		generations.push_back(0);
+		return slots.size() - 1;
+	}
+
+	void close(const size_t slot, std::vector<sighting>& closed)
+	{
+		//the plate may have other sightings open (see observe()), those stay
+		const auto indexed = slots_by_number.find(slots[slot].number);
+		if(indexed != slots_by_number.end())
+		{
+			auto& open = indexed->second;
+			open.erase(std::remove(open.begin(), open.end(), slot), open.end());
+			if(open.empty())
+				slots_by_number.erase(indexed);
+		}
+
+		closed.push_back(std::move(slots[slot]));
+		slots[slot] = sighting();
+		generations[slot]++;
+		free_slots.push_back(slot);
+		stats.sightings_closed++;
+	}
+
+public:
+	explicit sighting_index(const sighting_options& options = sighting_options())
+		: options(options)
+	{
+	}
+
+	//the same plate read by different cameras (or OCR-ed twice) differs in spaces, dashes and letter case, but nothing else
+	static void normalize(const std::string& number, std::string& result)
+	{
+		result.clear();
+		for(const auto c : number)
+			if(std::isalnum(static_cast<unsigned char>(c)))
+				result.push_back(static_cast<char>(std::toupper(static_cast<unsigned char>(c))));
+	}
+
+	//add a read, true if it starts a new sighting (the plate was not seen within the window)
+	//reads may come out of order (cameras with pipelines of different lengths, or one catching up after an outage), a read joins
+	//the open sighting of its plate whose window it falls into - wherever in time that sighting is, as long as it is not closed yet
+	//reads without any alphanumeric characters are ignored
+	bool observe(const std::string& number, const std::time_t when, const int confidence)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		normalize(number, normalized);
+		if(normalized.empty())
+			return false;
+
+		stats.reads++;
+
+		const auto window = static_cast<std::time_t>(options.window.count());
+		auto& open = slots_by_number[normalized];
+		for(const auto slot : open)
+		{
+			auto& current = slots[slot];
+
+			//a late read may be older than the last one, it still counts if it is close enough (on either side of the sighting)
+			if(when < current.first_seen - window || when > current.last_seen + window)
+				continue;
+
+			current.first_seen = std::min(current.first_seen, when);
+			if(when > current.last_seen)
+			{
+				current.last_seen = when;
+				expiries.push(expiry { when, slot, generations[slot] });
+			}
+			current.best_confidence = std::max(current.best_confidence, confidence);
+			current.reads++;
+			return false;
+		}
+
+		//the plate is back after a gap (or this is a read from before one) and expire() has not closed the other sightings yet,
+		//they stay open next to the new one
+		const auto slot = take_slot();
+		auto& created = slots[slot];
+		created.number = normalized;
+		created.first_seen = when;
+		created.last_seen = when;
+		created.best_confidence = confidence;
+		created.reads = 1;
+		open.insert(std::upper_bound(open.begin(), open.end(), when,
+			[this](const std::time_t first_seen, const size_t other) { return first_seen < slots[other].first_seen; }), slot);
+		expiries.push(expiry { when, slot, generations[slot] });
+		stats.sightings_opened++;
+		return true;
+	}
+
+	//close the sightings whose plates have not been read for a whole window before 'now', they are appended to 'closed'
+	void expire(const std::time_t now, std::vector<sighting>& closed)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		while(!expiries.empty() && now - expiries.top().last_seen > options.window.count())
+		{
+			const auto entry = expiries.top();
+			expiries.pop();
+
+			//stale entries - the sighting was read again later (it has a newer entry), or it is closed already
+			if(generations[entry.slot] != entry.generation || slots[entry.slot].last_seen != entry.last_seen)
+				continue;
+
+			close(entry.slot, closed);
+		}
+	}
+
+	//close everything, for a shutdown
+	void close_all(std::vector<sighting>& closed)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		while(!expiries.empty())
+		{
+			const auto entry = expiries.top();
+			expiries.pop();
+			if(generations[entry.slot] == entry.generation && slots[entry.slot].last_seen == entry.last_seen)
+				close(entry.slot, closed);
+		}
+	}
+
+	//the latest open sighting of a plate, false if there is none
+	bool find(const std::string& number, sighting& result) const
+	{
+		std::string key;
+		normalize(number, key);
+
+		std::lock_guard<std::mutex> lock(sync);
+		const auto existing = slots_by_number.find(key);
+		if(existing == slots_by_number.end())
+			return false;
+
+		result = slots[existing->second.back()];
+		return true;
+	}
+
+	sighting_stats statistics() const
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		auto result = stats;
+		result.open_sightings = stats.sightings_opened - stats.sightings_closed;
+		return result;
+	}
+};
+
+#endif // SIGHTING_INDEX_HPP
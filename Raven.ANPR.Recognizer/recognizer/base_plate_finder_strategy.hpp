@@ -3,12 +3,22 @@
 
 #include <string>
 #include <opencv2/imgproc.hpp>
+#include "plate_candidate.hpp"
+#include "frame_context.hpp"
+#include "candidate_normalization.hpp"
 
 class base_plate_finder_strategy
 {
 public:
 	virtual ~base_plate_finder_strategy() = default;
-	virtual bool try_find_and_crop_plate_number(const cv::Mat& image, std::vector<cv::Mat>& results) = 0;
+	virtual bool try_find_and_crop_plate_number(frame_context& frame, std::vector<plate_candidate>& results) = 0;
+
+	//convenience overload for a one-off image, nothing is shared or reused between calls
+	bool try_find_and_crop_plate_number(const cv::Mat& image, std::vector<plate_candidate>& results)
+	{
+		frame_context frame(image);
+		return try_find_and_crop_plate_number(frame, results);
+	}
 };
 
 #endif // BASE_PARSE_STRATEGY_HPP
@@ -0,0 +1,51 @@
+#ifndef BATCH_STATS_HPP
+#define BATCH_STATS_HPP
+
+#include <chrono>
+#include <cstddef>
+
+//throughput counters of a single pipeline stage
+struct pipeline_stage_stats
+{
+	size_t processed_items = 0;
+
+	//time the workers of the stage spent doing actual work (summed over all workers, waiting on queues is excluded)
+	std::chrono::nanoseconds busy_time{0};
+
+	size_t workers = 0;
+
+	//how many items per second the stage can process with all of its workers busy
+	double items_per_second() const
+	{
+		const auto seconds = std::chrono::duration<double>(busy_time).count();
+		return seconds > 0.0 ? processed_items * static_cast<double>(workers) / seconds : 0.0;
+	}
+
+	pipeline_stage_stats& operator+=(const pipeline_stage_stats& other)
+	{
+		processed_items += other.processed_items;
+		busy_time += other.busy_time;
+		return *this;
+	}
+};
+
+//counters of a single try_parse_batch() call
+struct batch_stats
+{
+	pipeline_stage_stats decode;
+	pipeline_stage_stats detect;
+	pipeline_stage_stats ocr;
+
+	//images that could not be decoded (or were empty), those get an empty result set
+	size_t failed_images = 0;
+
+	std::chrono::nanoseconds wall_time{0};
+
+	double images_per_second() const
+	{
+		const auto seconds = std::chrono::duration<double>(wall_time).count();
+		return seconds > 0.0 ? decode.processed_items / seconds : 0.0;
+	}
+};
+
+#endif // BATCH_STATS_HPP
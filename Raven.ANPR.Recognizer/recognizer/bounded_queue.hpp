@@ -0,0 +1,115 @@
+#ifndef BOUNDED_QUEUE_HPP
+#define BOUNDED_QUEUE_HPP
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+//multi-producer, multi-consumer FIFO queue with a fixed capacity
+//producers block (or fail with try_push) when the queue is full, this way a fast stage cannot run away from a slow one
+//once closed, consumers drain the remaining items and then pop() returns false
+template<typename T>
+class bounded_queue
+{
+private:
+	std::deque<T> items;
+	size_t capacity;
+	bool closed = false;
+
+	mutable std::mutex sync;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+
+public:
+	explicit bounded_queue(size_t capacity)
+		: capacity(capacity > 0 ? capacity : 1)
+	{
+	}
+
+	bounded_queue(const bounded_queue& other) = delete;
+	bounded_queue& operator=(const bounded_queue& other) = delete;
+
+	//blocks while the queue is full, returns false if the queue was closed
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lock(sync);
+		not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+		if(closed)
+			return false;
+
+		items.push_back(std::move(item));
+		lock.unlock();
+		not_empty.notify_one();
+		return true;
+	}
+
+	//never blocks, returns false if the queue is full or closed
+	bool try_push(T item)
+	{
+		std::unique_lock<std::mutex> lock(sync);
+		if(closed || items.size() >= capacity)
+			return false;
+
+		items.push_back(std::move(item));
+		lock.unlock();
+		not_empty.notify_one();
+		return true;
+	}
+
+	//blocks while the queue is empty, returns false once the queue is closed and drained
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lock(sync);
+		not_empty.wait(lock, [this] { return closed || !items.empty(); });
+		if(items.empty())
+			return false;
+
+		item = std::move(items.front());
+		items.pop_front();
+		lock.unlock();
+		not_full.notify_one();
+		return true;
+	}
+
+	//like pop(), but gives up after 'timeout', returns false if nothing was popped
+	template<typename TDuration>
+	bool pop_for(T& item, const TDuration& timeout)
+	{
+		std::unique_lock<std::mutex> lock(sync);
+		if(!not_empty.wait_for(lock, timeout, [this] { return closed || !items.empty(); }) || items.empty())
+			return false;
+
+		item = std::move(items.front());
+		items.pop_front();
+		lock.unlock();
+		not_full.notify_one();
+		return true;
+	}
+
+	//no more items can be pushed, consumers will still get whatever is left in the queue
+	void close()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sync);
+			closed = true;
+		}
+		not_empty.notify_all();
+		not_full.notify_all();
+	}
+
+	bool is_closed() const
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		return closed;
+	}
+
+	size_t size() const
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		return items.size();
+	}
+
+	size_t max_size() const { return capacity; }
+};
+
+#endif // BOUNDED_QUEUE_HPP
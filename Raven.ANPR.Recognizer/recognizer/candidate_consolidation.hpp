@@ -0,0 +1,67 @@
+#ifndef CANDIDATE_CONSOLIDATION_HPP
+#define CANDIDATE_CONSOLIDATION_HPP
+
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include "plate_candidate.hpp"
+
+//collapse plate candidates of a strategy that show the same physical region of the image, so each region gets OCR-ed only once per strategy
+//(different character sequences of the same strategy often find the same plate)
+//candidates of different strategies are never collapsed - their crops differ, and the one the geometry looks worse for
+//can be the one that reads, so all of them are OCR-ed and the merge of the reads keeps the most confident one
+struct candidate_consolidation
+{
+	static double intersection_over_union(const cv::Rect& a, const cv::Rect& b)
+	{
+		const auto intersection = (a & b).area();
+		if(intersection <= 0)
+			return 0.0;
+
+		return static_cast<double>(intersection) / static_cast<double>(a.area() + b.area() - intersection);
+	}
+
+	//drop candidates whose region overlaps a bigger candidate of the same strategy by at least 'max_iou'
+	//bigger regions win since they are more likely to contain the whole plate and not just part of its characters
+	//the candidates that are kept stay in their original order
+	static void suppress_overlapping(std::vector<plate_candidate>& candidates, const double max_iou)
+	{
+		if(candidates.size() < 2 || max_iou > 1.0)
+			return;
+
+		std::vector<size_t> by_area(candidates.size());
+		std::iota(by_area.begin(), by_area.end(), 0);
+		std::stable_sort(by_area.begin(), by_area.end(),
+			[&](const size_t a, const size_t b) { return candidates[a].region.area() > candidates[b].region.area(); });
+
+		std::vector<bool> keep(candidates.size(), false);
+		std::vector<size_t> kept;
+		for(const auto i : by_area)
+		{
+			const auto overlaps_kept = std::any_of(kept.begin(), kept.end(),
+				[&](const size_t k)
+				{
+					return candidates[i].strategy_index == candidates[k].strategy_index &&
+						intersection_over_union(candidates[i].region, candidates[k].region) >= max_iou;
+				});
+			if(overlaps_kept)
+				continue;
+
+			keep[i] = true;
+			kept.push_back(i);
+		}
+
+		size_t next = 0;
+		for(size_t i = 0; i < candidates.size(); i++)
+		{
+			if(!keep[i])
+				continue;
+			if(next != i)
+				candidates[next] = std::move(candidates[i]);
+			next++;
+		}
+		candidates.resize(next);
+	}
+};
+
+#endif // CANDIDATE_CONSOLIDATION_HPP
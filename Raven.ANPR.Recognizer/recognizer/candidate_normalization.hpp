@@ -0,0 +1,68 @@
+#ifndef CANDIDATE_NORMALIZATION_HPP
+#define CANDIDATE_NORMALIZATION_HPP
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include "plate_candidate.hpp"
+#include "raw_frame.hpp"
+
+//turn a crop into the image OCR is given: single channel 8 bit grayscale, a fixed height, dark text on light and padded with white
+//that is a quarter of the bytes of an RGBA image, and every plate comes in at about the same text size
+//the image is deliberately not binarized - tesseract's LSTM engine reads the grayscale it is given, and thresholding it first
+//throws away the edge detail it relies on; the glyph classifier binarizes each character on its own (see glyph_classifier::normalize())
+struct candidate_normalization
+{
+	//height of the plate after normalization (without the padding), the characters end up at about two thirds of it
+	static constexpr int plate_height = 48;
+
+	//white margin around the plate, tesseract does poorly with text that touches the border of the image
+	static constexpr int padding = 8;
+
+	//normalize 'cropped' (BGR, RGB(A) or grayscale, see frame_context::crop_source()) into candidate.image
+	//candidate.characters are expected in the coordinates of 'cropped' and are mapped into the normalized image
+	//'gray' and 'resized' are scratch buffers, their memory is reused if they already have the right size,
+	//candidate.image always gets its own memory (so 'cropped' can be a reused buffer too)
+	static void normalize(const cv::Mat& cropped, const pixel_format format, cv::Mat& gray, cv::Mat& resized, plate_candidate& candidate)
+	{
+		if(cropped.empty())
+		{
+			candidate.image.release();
+			candidate.characters.clear();
+			return;
+		}
+
+		const cv::Mat* single_channel = &cropped;
+		if(cropped.channels() == 4)
+		{
+			cv::cvtColor(cropped, gray, format == pixel_format::rgba ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGRA2GRAY);
+			single_channel = &gray;
+		}
+		else if(cropped.channels() == 3)
+		{
+			cv::cvtColor(cropped, gray, format == pixel_format::rgb ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY);
+			single_channel = &gray;
+		}
+
+		const auto scale = static_cast<double>(plate_height) / cropped.rows;
+		const cv::Size size(std::max(1, static_cast<int>(cropped.cols * scale + 0.5)), plate_height);
+		cv::resize(*single_channel, resized, size, 0, 0, scale < 1.0 ? cv::INTER_AREA : cv::INTER_LINEAR);
+
+		//the plate is mostly background, so if most of it is on the dark side of the Otsu threshold the text is light on a dark plate
+		//(the binarized image only decides the polarity, 'gray' is free to hold it since the resize has already read it)
+		cv::threshold(resized, gray, 0, 255, cv::THRESH_BINARY | cv::THRESH_OTSU);
+		if(cv::countNonZero(gray) * 2 < gray.rows * gray.cols)
+			cv::bitwise_not(resized, resized);
+
+		cv::copyMakeBorder(resized, candidate.image, padding, padding, padding, padding, cv::BORDER_CONSTANT, cv::Scalar(255));
+
+		const cv::Rect image_bounds(0, 0, candidate.image.cols, candidate.image.rows);
+		for(auto& character : candidate.characters)
+		{
+			character = cv::Rect(
+				cv::Point(static_cast<int>(character.x * scale) + padding, static_cast<int>(character.y * scale) + padding),
+				cv::Point(static_cast<int>(character.br().x * scale + 0.5) + padding, static_cast<int>(character.br().y * scale + 0.5) + padding)) & image_bounds;
+		}
+	}
+};
+
+#endif // CANDIDATE_NORMALIZATION_HPP
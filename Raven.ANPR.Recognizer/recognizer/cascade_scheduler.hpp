@@ -0,0 +1,124 @@
+#ifndef CASCADE_SCHEDULER_HPP
+#define CASCADE_SCHEDULER_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <numeric>
+#include <vector>
+#include "plate_candidate.hpp"
+
+//counters of the cascade mode of plate_recognizer::try_parse()
+struct cascade_stats
+{
+	size_t frames = 0;
+
+	//frames where a confident read was found before all of the work was done
+	size_t early_exits = 0;
+
+	//strategies that did not run and candidates that were not OCR-ed thanks to the early exits
+	size_t strategies_skipped = 0;
+	size_t candidates_skipped = 0;
+
+	size_t ocr_calls = 0;
+
+	double early_exit_rate() const
+	{
+		return frames > 0 ? static_cast<double>(early_exits) / static_cast<double>(frames) : 0.0;
+	}
+};
+
+//decides in which order the cascade does its work - strategies from the cheapest to the most expensive (as measured so far),
+//and candidates of a strategy from the most plate-like to the least
+//a single instance is shared by all of the threads of a recognizer, so everything is guarded by a mutex
+class cascade_scheduler
+{
+private:
+	//weight of the latest measurement in the moving average of strategy cost
+	static constexpr double cost_smoothing = 0.2;
+
+	mutable std::mutex sync;
+
+	//exponential moving average of the time each strategy takes (in nanoseconds), zero means not measured yet
+	std::vector<double> average_cost;
+
+	cascade_stats stats;
+
+public:
+	explicit cascade_scheduler(const size_t strategy_count)
+		: average_cost(strategy_count, 0.0)
+	{
+	}
+
+	cascade_scheduler(const cascade_scheduler& other) = delete;
+	cascade_scheduler& operator=(const cascade_scheduler& other) = delete;
+
+	void record_strategy_cost(const size_t strategy_index, const std::chrono::nanoseconds elapsed)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		auto& cost = average_cost[strategy_index];
+		const auto measured = static_cast<double>(elapsed.count());
+		cost = cost == 0.0 ? measured : cost + cost_smoothing * (measured - cost);
+	}
+
+	//strategy indexes from the cheapest to the most expensive one
+	//strategies that were not measured yet go first (in the order they were registered), so they get measured
+	std::vector<size_t> strategies_by_cost() const
+	{
+		std::vector<size_t> order(average_cost.size());
+		std::iota(order.begin(), order.end(), 0);
+
+		std::lock_guard<std::mutex> lock(sync);
+		std::stable_sort(order.begin(), order.end(),
+			[this](const size_t a, const size_t b) { return average_cost[a] < average_cost[b]; });
+		return order;
+	}
+
+	void record_frame(const bool early_exit, const size_t strategies_skipped, const size_t candidates_skipped, const size_t ocr_calls)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		stats.frames++;
+		if(early_exit)
+			stats.early_exits++;
+		stats.strategies_skipped += strategies_skipped;
+		stats.candidates_skipped += candidates_skipped;
+		stats.ocr_calls += ocr_calls;
+	}
+
+	cascade_stats statistics() const
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		return stats;
+	}
+
+	//cheap prior of how likely a candidate is to be a plate - the closer its aspect ratio is to the expected one, the better
+	//(bigger regions win ties, they are more likely to contain all of the characters)
+	static void order_by_prior(std::vector<plate_candidate>& candidates, const double expected_aspect_ratio)
+	{
+		if(candidates.size() < 2 || expected_aspect_ratio <= 0.0)
+			return;
+
+		const auto distance_from_expected = [expected_aspect_ratio](const cv::Rect& region)
+		{
+			if(region.width <= 0 || region.height <= 0)
+				return std::numeric_limits<double>::max();
+
+			//log scale, so twice too wide is as bad as twice too narrow
+			return std::abs(std::log(static_cast<double>(region.width) / region.height / expected_aspect_ratio));
+		};
+
+		std::stable_sort(candidates.begin(), candidates.end(),
+			[&](const plate_candidate& a, const plate_candidate& b)
+			{
+				const auto a_distance = distance_from_expected(a.region);
+				const auto b_distance = distance_from_expected(b.region);
+				if(a_distance != b_distance)
+					return a_distance < b_distance;
+				return a.region.area() > b.region.area();
+			});
+	}
+};
+
+#endif // CASCADE_SCHEDULER_HPP
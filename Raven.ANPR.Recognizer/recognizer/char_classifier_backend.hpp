@@ -0,0 +1,163 @@
+#ifndef CHAR_CLASSIFIER_BACKEND_HPP
+#define CHAR_CLASSIFIER_BACKEND_HPP
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include "ocr_backend.hpp"
+#include "glyph_classifier.hpp"
+
+//fast OCR that classifies the characters of a plate one by one with a glyph_classifier, instead of running tesseract on the whole plate
+//the characters come from the strategy that found the plate (plate_candidate::characters), or are segmented here if it didn't provide them
+//a read where any character is below 'min_char_confidence' goes to the fallback backend (usually tesseract) as a whole
+class char_classifier_backend final : public ocr_backend
+{
+private:
+	std::shared_ptr<const glyph_classifier> classifier;
+	std::shared_ptr<ocr_backend> fallback;
+	int min_char_confidence;
+
+	std::atomic<size_t> classified_reads{0};
+	std::atomic<size_t> fallback_reads{0};
+
+	//connected components of 'ink' that look like characters of a single line of text, from left to right
+	static void find_character_components(const cv::Mat& ink, std::vector<cv::Rect>& characters)
+	{
+		cv::Mat labels, stats, centroids;
+		const auto component_count = cv::connectedComponentsWithStats(ink, labels, stats, centroids, 8, CV_32S);
+
+		std::vector<cv::Rect> components;
+		for(auto i = 1; i < component_count; i++)
+		{
+			const cv::Rect box(
+				stats.at<int>(i, cv::CC_STAT_LEFT), stats.at<int>(i, cv::CC_STAT_TOP),
+				stats.at<int>(i, cv::CC_STAT_WIDTH), stats.at<int>(i, cv::CC_STAT_HEIGHT));
+
+			//the plate's border and the specks around the characters are the usual suspects here
+			if(box.height < 8 || box.height < ink.rows * 0.3 || box.height > ink.rows * 0.95 ||
+				box.width > box.height * 1.2 || stats.at<int>(i, cv::CC_STAT_AREA) < 15)
+				continue;
+
+			components.push_back(box);
+		}
+
+		if(components.empty())
+			return;
+
+		//characters of a plate have about the same height, which leaves out the rest (like screws or a sticker)
+		std::vector<int> heights;
+		for(const auto& box : components)
+			heights.push_back(box.height);
+		std::nth_element(heights.begin(), heights.begin() + heights.size() / 2, heights.end());
+		const auto median_height = heights[heights.size() / 2];
+
+		for(const auto& box : components)
+			if(std::abs(box.height - median_height) <= median_height * 0.25)
+				characters.push_back(box);
+
+		std::sort(characters.begin(), characters.end(), [](const cv::Rect& a, const cv::Rect& b) { return a.x < b.x; });
+	}
+
+public:
+	//'fallback' may be null, then reads with uncertain characters are simply not successful
+	//without a classifier, the built-in one (see glyph_classifier::with_rendered_glyphs()) is used
+	explicit char_classifier_backend(
+		std::shared_ptr<ocr_backend> fallback,
+		const int min_char_confidence = 40,
+		std::shared_ptr<const glyph_classifier> classifier = nullptr)
+		: classifier(classifier != nullptr ? std::move(classifier) : std::make_shared<const glyph_classifier>(glyph_classifier::with_rendered_glyphs())),
+		  fallback(std::move(fallback)),
+		  min_char_confidence(min_char_confidence)
+	{
+	}
+
+	//boxes of the characters of a plate image, from left to right
+	//dark characters on a light plate are tried first, then the other way around
+	static void segment_characters(const cv::Mat& plate_image, std::vector<cv::Rect>& characters)
+	{
+		characters.clear();
+		if(plate_image.empty())
+			return;
+
+		cv::Mat gray;
+		if(plate_image.channels() == 4)
+			cv::cvtColor(plate_image, gray, cv::COLOR_RGBA2GRAY);
+		else if(plate_image.channels() == 3)
+			cv::cvtColor(plate_image, gray, cv::COLOR_BGR2GRAY);
+		else
+			gray = plate_image;
+
+		cv::Mat ink;
+		cv::threshold(gray, ink, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+		find_character_components(ink, characters);
+		if(characters.size() > 3)
+			return;
+
+		characters.clear();
+		cv::bitwise_not(ink, ink);
+		find_character_components(ink, characters);
+	}
+
+	//classify the characters of the candidate, true only if there are enough of them and all of them are confident
+	//the text and confidences are filled in even when it fails
+	bool try_classify(const plate_candidate& candidate, ocr_read& read) const
+	{
+		std::vector<cv::Rect> segmented;
+		if(candidate.characters.empty())
+			segment_characters(candidate.image, segmented);
+		const auto& characters = candidate.characters.empty() ? segmented : candidate.characters;
+
+		const cv::Rect image_bounds(0, 0, candidate.image.cols, candidate.image.rows);
+		auto all_confident = true;
+		auto total_confidence = 0;
+		std::vector<float> features;
+		for(const auto& character : characters)
+		{
+			const auto box = character & image_bounds;
+			char label;
+			int confidence;
+			if(box.area() == 0 ||
+				!glyph_classifier::normalize(candidate.image(box), features) ||
+				!classifier->classify(features, label, confidence))
+				continue;
+
+			read.text.push_back(label);
+			read.char_confidences.push_back(confidence);
+			total_confidence += confidence;
+			all_confident &= confidence >= min_char_confidence;
+		}
+
+		read.confidence = read.text.empty() ? 0 : total_confidence / static_cast<int>(read.text.size());
+		return read.succeeded = all_confident && read.text.size() > 3;
+	}
+
+	bool try_read(const plate_candidate& candidate, ocr_read& read) override
+	{
+		if(try_classify(candidate, read))
+		{
+			classified_reads++;
+			return true;
+		}
+
+		if(fallback == nullptr)
+			return false;
+
+		fallback_reads++;
+		read = ocr_read();
+		return fallback->try_read(candidate, read);
+	}
+
+	//classification is CPU only, the reads that fall back simply wait for a tesseract engine
+	size_t concurrency() const override
+	{
+		return std::max<size_t>(std::max(1u, std::thread::hardware_concurrency()), fallback != nullptr ? fallback->concurrency() : 0);
+	}
+
+	//reads that were answered by the classifier and reads that were handed to the fallback backend
+	size_t classified_count() const { return classified_reads; }
+	size_t fallback_count() const { return fallback_reads; }
+};
+
+#endif // CHAR_CLASSIFIER_BACKEND_HPP
@@ -0,0 +1,108 @@
+#ifndef CHAR_GRID_HPP
+#define CHAR_GRID_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "if_char.hpp"
+
+//uniform grid over the centres of possible characters
+//finding the neighbours of a character visits only the grid cells around it, instead of every other character in the frame
+//(on cluttered scenes there are thousands of char-like contours, so the difference is huge)
+class char_grid
+{
+private:
+	//don't let a tiny cell size blow up memory on a huge frame
+	static constexpr size_t max_cells = 1 << 20;
+
+	double cell_size = 1.0;
+	double min_x = 0.0;
+	double min_y = 0.0;
+	int columns = 0;
+	int rows = 0;
+
+	//cells are stored in a compressed layout - items of cell 'c' are cell_items[cell_start[c] .. cell_start[c + 1])
+	//within a cell, items are in ascending order
+	std::vector<size_t> cell_start;
+	std::vector<size_t> cell_items;
+
+	int column_of(const double x) const { return std::clamp(static_cast<int>((x - min_x) / cell_size), 0, columns - 1); }
+	int row_of(const double y) const { return std::clamp(static_cast<int>((y - min_y) / cell_size), 0, rows - 1); }
+
+public:
+	//index the centres of 'chars', the cell size should be roughly the typical query radius
+	void build(const std::vector<if_char>& chars, double preferred_cell_size)
+	{
+		cell_start.clear();
+		cell_items.clear();
+		columns = rows = 0;
+
+		if(chars.empty())
+			return;
+
+		auto max_x = chars[0].center_x();
+		auto max_y = chars[0].center_y();
+		min_x = max_x;
+		min_y = max_y;
+		for(const auto& c : chars)
+		{
+			min_x = std::min(min_x, c.center_x());
+			min_y = std::min(min_y, c.center_y());
+			max_x = std::max(max_x, c.center_x());
+			max_y = std::max(max_y, c.center_y());
+		}
+
+		cell_size = std::max(1.0, preferred_cell_size);
+		const auto area = (max_x - min_x + 1.0) * (max_y - min_y + 1.0);
+		if(area / (cell_size * cell_size) > max_cells)
+			cell_size = std::sqrt(area / max_cells);
+
+		columns = static_cast<int>((max_x - min_x) / cell_size) + 1;
+		rows = static_cast<int>((max_y - min_y) / cell_size) + 1;
+
+		//count the items per cell, then turn the counts into offsets and place the items
+		cell_start.assign(static_cast<size_t>(columns) * rows + 1, 0);
+		std::vector<size_t> cell_of_item(chars.size());
+		for(size_t i = 0; i < chars.size(); i++)
+		{
+			cell_of_item[i] = static_cast<size_t>(row_of(chars[i].center_y())) * columns + column_of(chars[i].center_x());
+			cell_start[cell_of_item[i] + 1]++;
+		}
+
+		for(size_t c = 1; c < cell_start.size(); c++)
+			cell_start[c] += cell_start[c - 1];
+
+		cell_items.resize(chars.size());
+		auto next_slot = cell_start;
+		for(size_t i = 0; i < chars.size(); i++)
+			cell_items[next_slot[cell_of_item[i]]++] = i;
+	}
+
+	//collect indexes of all characters whose centres *may* be within 'radius' of (x, y), in ascending order
+	//(this is a coarse filter - the caller still has to check the exact distance)
+	void query(const double x, const double y, const double radius, std::vector<size_t>& result) const
+	{
+		result.clear();
+		if(columns == 0)
+			return;
+
+		const auto first_column = column_of(x - radius);
+		const auto last_column = column_of(x + radius);
+		const auto first_row = row_of(y - radius);
+		const auto last_row = row_of(y + radius);
+
+		for(auto row = first_row; row <= last_row; row++)
+		{
+			for(auto column = first_column; column <= last_column; column++)
+			{
+				const auto cell = static_cast<size_t>(row) * columns + column;
+				result.insert(result.end(), cell_items.begin() + cell_start[cell], cell_items.begin() + cell_start[cell + 1]);
+			}
+		}
+
+		//callers rely on the same order as a plain scan over all of the characters
+		std::sort(result.begin(), result.end());
+	}
+};
+
+#endif // CHAR_GRID_HPP
@@ -0,0 +1,116 @@
+#ifndef CONTOUR_ARENA_HPP
+#define CONTOUR_ARENA_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <vector>
+
+//read-only view of the points of a single contour, nothing is copied
+//it points into the storage it was taken from (usually a contour_arena), so it is valid only until that storage is refilled
+struct contour_view
+{
+	const cv::Point* points = nullptr;
+	size_t count = 0;
+
+	contour_view() = default;
+
+	contour_view(const cv::Point* points, const size_t count)
+		: points(points),
+		  count(count)
+	{
+	}
+
+	explicit contour_view(const std::vector<cv::Point>& contour)
+		: points(contour.data()),
+		  count(contour.size())
+	{
+	}
+
+	const cv::Point* begin() const { return points; }
+	const cv::Point* end() const { return points + count; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	const cv::Point& operator[](const size_t i) const { return points[i]; }
+
+	//a cv::Mat header over the points (count x 1, CV_32SC2) for OpenCV calls like contourArea() or approxPolyDP()
+	//the header is read-only by contract, the const is cast away only because cv::Mat has no const view
+	cv::Mat as_mat() const
+	{
+		return cv::Mat(static_cast<int>(count), 1, CV_32SC2, const_cast<cv::Point*>(points));
+	}
+
+	friend bool operator==(const contour_view& lhs, const contour_view& rhs)
+	{
+		return lhs.count == rhs.count && std::equal(lhs.begin(), lhs.end(), rhs.begin());
+	}
+
+	friend bool operator!=(const contour_view& lhs, const contour_view& rhs) { return !(lhs == rhs); }
+};
+
+//all of the contours of a frame in one flat buffer of points, contours are referred to by index (or by contour_view)
+//the buffers keep their capacity when the arena is refilled, so once it has seen a busy frame, the next frames allocate nothing
+//(cv::findContours() can only write nested vectors, those are kept around between frames as well, so their capacity is reused too)
+//note: not thread-safe, every strategy has its own arena (see frame_context::contours())
+class contour_arena
+{
+private:
+	std::vector<cv::Point> points;
+
+	//contour 'i' is points[offsets[i] .. offsets[i + 1])
+	std::vector<size_t> offsets { 0 };
+
+	//output of cv::findContours()
+	std::vector<std::vector<cv::Point>> found;
+
+public:
+	void clear()
+	{
+		points.clear();
+		offsets.resize(1);
+	}
+
+	//number of contours
+	size_t size() const { return offsets.size() - 1; }
+	bool empty() const { return size() == 0; }
+
+	//number of points of all of the contours together
+	size_t point_count() const { return points.size(); }
+
+	contour_view operator[](const size_t i) const
+	{
+		return contour_view(points.data() + offsets[i], offsets[i + 1] - offsets[i]);
+	}
+
+	//append a contour, returns its index
+	//views taken before this call are invalidated (the points may move)
+	size_t add(const cv::Point* contour, const size_t count)
+	{
+		points.insert(points.end(), contour, contour + count);
+		offsets.push_back(points.size());
+		return size() - 1;
+	}
+
+	size_t add(const std::vector<cv::Point>& contour)
+	{
+		return add(contour.data(), contour.size());
+	}
+
+	//replace the contents of the arena with the contours of a binary image (see cv::findContours())
+	void find_contours(const cv::Mat& image, const int mode, const int method)
+	{
+		cv::findContours(image, found, mode, method);
+
+		clear();
+		size_t total_points = 0;
+		for(const auto& contour : found)
+			total_points += contour.size();
+		points.reserve(total_points);
+		offsets.reserve(found.size() + 1);
+
+		for(const auto& contour : found)
+			add(contour);
+	}
+};
+
+#endif // CONTOUR_ARENA_HPP
@@ -0,0 +1,244 @@
+#ifndef CONTRAST_KERNEL_HPP
+#define CONTRAST_KERNEL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <opencv2/core.hpp>
+
+//the instruction set is picked at compile time - SSE2 is always there on x64, AVX2 only if the compiler is told it may use it
+//(see RAVEN_ANPR_ENABLE_AVX2 in CMakeLists.txt), anything else (like the ARM of a Raspberry Pi) gets the scalar code
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define CONTRAST_KERNEL_AVX2
+#define CONTRAST_KERNEL_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CONTRAST_KERNEL_SSE2
+#endif
+
+//contrast enhancement of the geometry strategy: gray + tophat - blackhat, with a 3x3 rectangle and saturating 8 bit arithmetic
+//bit-exact with the OpenCV chain it replaces:
+//	morphologyEx(gray, top_hat, MORPH_TOPHAT, 3x3); morphologyEx(gray, black_hat, MORPH_BLACKHAT, 3x3);
+//	add(gray, top_hat, sum); subtract(sum, black_hat, result);
+//but done in a single pass over the rows, with a few rows of scratch instead of four full frame images
+//
+//how it works: tophat = gray - open(gray) and blackhat = close(gray) - gray, where open = dilate(erode()) and close = erode(dilate())
+//a 3x3 min/max is separable (a 3 wide horizontal pass, then a 3 tall vertical one), and pixels outside of the image are ignored,
+//which is the same as repeating the edge pixels - so every row only needs its neighbours, kept in small ring buffers
+struct contrast_kernel
+{
+	//bytes of scratch apply() needs for a given width
+	static size_t scratch_size(const int width) { return static_cast<size_t>(scratch_rows) * width; }
+
+	//'scratch' must have at least scratch_size(width) bytes, 'src' and 'dst' must not overlap
+	static void apply(const uint8_t* src, const size_t src_stride, uint8_t* dst, const size_t dst_stride, const int width, const int height, uint8_t* scratch)
+	{
+		run<true>(src, src_stride, dst, dst_stride, width, height, scratch);
+	}
+
+	//the same without any SIMD, the reference the vectorized code is tested against
+	static void apply_scalar(const uint8_t* src, const size_t src_stride, uint8_t* dst, const size_t dst_stride, const int width, const int height, uint8_t* scratch)
+	{
+		run<false>(src, src_stride, dst, dst_stride, width, height, scratch);
+	}
+
+	//'gray' is 8 bit single channel, 'result' and 'scratch' are output buffers, their memory is reused if they already have the right size
+	static void apply(const cv::Mat& gray, cv::Mat& result, cv::Mat& scratch)
+	{
+		if(gray.type() != CV_8UC1)
+			throw std::invalid_argument("The contrast kernel works only on 8 bit grayscale images");
+
+		result.create(gray.size(), CV_8UC1);
+		scratch.create(scratch_rows, std::max(1, gray.cols), CV_8UC1);
+		if(gray.empty())
+			return;
+
+		apply(gray.data, gray.step, result.data, result.step, gray.cols, gray.rows, scratch.data);
+	}
+
+private:
+	//3 rows of horizontal min and max of the source, 3 rows of horizontal max of the erosion and min of the dilation,
+	//plus one row each for the erosion, dilation, opening and closing that are being worked on
+	static constexpr int scratch_rows = 16;
+
+	struct min_op
+	{
+		static uint8_t apply(const uint8_t a, const uint8_t b) { return std::min(a, b); }
+#if defined(CONTRAST_KERNEL_SSE2)
+		static __m128i apply(const __m128i a, const __m128i b) { return _mm_min_epu8(a, b); }
+#endif
+#if defined(CONTRAST_KERNEL_AVX2)
+		static __m256i apply(const __m256i a, const __m256i b) { return _mm256_min_epu8(a, b); }
+#endif
+	};
+
+	struct max_op
+	{
+		static uint8_t apply(const uint8_t a, const uint8_t b) { return std::max(a, b); }
+#if defined(CONTRAST_KERNEL_SSE2)
+		static __m128i apply(const __m128i a, const __m128i b) { return _mm_max_epu8(a, b); }
+#endif
+#if defined(CONTRAST_KERNEL_AVX2)
+		static __m256i apply(const __m256i a, const __m256i b) { return _mm256_max_epu8(a, b); }
+#endif
+	};
+
+	//out[x] = op(in[x - 1], in[x], in[x + 1]), the missing neighbours at the ends are left out
+	template<class op, bool simd>
+	static void horizontal(const uint8_t* in, uint8_t* out, const int width)
+	{
+		if(width == 1)
+		{
+			out[0] = in[0];
+			return;
+		}
+
+		out[0] = op::apply(in[0], in[1]);
+		out[width - 1] = op::apply(in[width - 2], in[width - 1]);
+
+		auto x = 1;
+		if constexpr(simd)
+		{
+#if defined(CONTRAST_KERNEL_AVX2)
+			for(; x + 33 <= width; x += 32)
+			{
+				const auto left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x - 1));
+				const auto center = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x));
+				const auto right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x + 1));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), op::apply(op::apply(left, center), right));
+			}
+#endif
+#if defined(CONTRAST_KERNEL_SSE2)
+			for(; x + 17 <= width; x += 16)
+			{
+				const auto left = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x - 1));
+				const auto center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x));
+				const auto right = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x + 1));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), op::apply(op::apply(left, center), right));
+			}
+#endif
+		}
+
+		for(; x < width - 1; x++)
+			out[x] = op::apply(op::apply(in[x - 1], in[x]), in[x + 1]);
+	}
+
+	//out[x] = op(above[x], row[x], below[x])
+	template<class op, bool simd>
+	static void vertical(const uint8_t* above, const uint8_t* row, const uint8_t* below, uint8_t* out, const int width)
+	{
+		auto x = 0;
+		if constexpr(simd)
+		{
+#if defined(CONTRAST_KERNEL_AVX2)
+			for(; x + 32 <= width; x += 32)
+			{
+				const auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(above + x));
+				const auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+				const auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(below + x));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), op::apply(op::apply(a, b), c));
+			}
+#endif
+#if defined(CONTRAST_KERNEL_SSE2)
+			for(; x + 16 <= width; x += 16)
+			{
+				const auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + x));
+				const auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+				const auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + x));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), op::apply(op::apply(a, b), c));
+			}
+#endif
+		}
+
+		for(; x < width; x++)
+			out[x] = op::apply(op::apply(above[x], row[x]), below[x]);
+	}
+
+	//out = (gray + (gray - opened)) - (closed - gray), each step saturated to 0-255 like cv::add() and cv::subtract() do
+	template<bool simd>
+	static void combine(const uint8_t* gray, const uint8_t* opened, const uint8_t* closed, uint8_t* out, const int width)
+	{
+		auto x = 0;
+		if constexpr(simd)
+		{
+#if defined(CONTRAST_KERNEL_AVX2)
+			for(; x + 32 <= width; x += 32)
+			{
+				const auto g = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(gray + x));
+				const auto top_hat = _mm256_subs_epu8(g, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(opened + x)));
+				const auto black_hat = _mm256_subs_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(closed + x)), g);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_subs_epu8(_mm256_adds_epu8(g, top_hat), black_hat));
+			}
+#endif
+#if defined(CONTRAST_KERNEL_SSE2)
+			for(; x + 16 <= width; x += 16)
+			{
+				const auto g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + x));
+				const auto top_hat = _mm_subs_epu8(g, _mm_loadu_si128(reinterpret_cast<const __m128i*>(opened + x)));
+				const auto black_hat = _mm_subs_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(closed + x)), g);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_subs_epu8(_mm_adds_epu8(g, top_hat), black_hat));
+			}
+#endif
+		}
+
+		for(; x < width; x++)
+		{
+			//opening never goes above the pixel and closing never below it, so the hats can't be negative
+			const auto top_hat = gray[x] - opened[x];
+			const auto black_hat = closed[x] - gray[x];
+			const auto sum = std::min(255, gray[x] + top_hat);
+			out[x] = static_cast<uint8_t>(std::max(0, sum - black_hat));
+		}
+	}
+
+	template<bool simd>
+	static void run(const uint8_t* src, const size_t src_stride, uint8_t* dst, const size_t dst_stride, const int width, const int height, uint8_t* scratch)
+	{
+		if(width <= 0 || height <= 0)
+			return;
+
+		const auto scratch_row = [&](const int index) { return scratch + static_cast<size_t>(index) * width; };
+
+		//rings of 3 rows, row 'r' lives in slot r % 3
+		const auto source_min = [&](const int r) { return scratch_row(r % 3); };
+		const auto source_max = [&](const int r) { return scratch_row(3 + r % 3); };
+		const auto eroded_max = [&](const int r) { return scratch_row(6 + r % 3); };
+		const auto dilated_min = [&](const int r) { return scratch_row(9 + r % 3); };
+		auto* eroded = scratch_row(12);
+		auto* dilated = scratch_row(13);
+		auto* opened = scratch_row(14);
+		auto* closed = scratch_row(15);
+
+		const auto clamp_row = [height](const int r) { return std::clamp(r, 0, height - 1); };
+		const auto source_row = [&](const int r) { return src + static_cast<size_t>(r) * src_stride; };
+
+		//the erosion/dilation of row r needs the source rows up to r + 1, the opening/closing of row y needs erosions up to y + 1
+		auto next_source = 0;
+		auto next_eroded = 0;
+		for(auto y = 0; y < height; y++)
+		{
+			for(; next_eroded <= clamp_row(y + 1); next_eroded++)
+			{
+				const auto r = next_eroded;
+				for(; next_source <= clamp_row(r + 1); next_source++)
+				{
+					horizontal<min_op, simd>(source_row(next_source), source_min(next_source), width);
+					horizontal<max_op, simd>(source_row(next_source), source_max(next_source), width);
+				}
+
+				vertical<min_op, simd>(source_min(clamp_row(r - 1)), source_min(r), source_min(clamp_row(r + 1)), eroded, width);
+				vertical<max_op, simd>(source_max(clamp_row(r - 1)), source_max(r), source_max(clamp_row(r + 1)), dilated, width);
+				horizontal<max_op, simd>(eroded, eroded_max(r), width);
+				horizontal<min_op, simd>(dilated, dilated_min(r), width);
+			}
+
+			vertical<max_op, simd>(eroded_max(clamp_row(y - 1)), eroded_max(y), eroded_max(clamp_row(y + 1)), opened, width);
+			vertical<min_op, simd>(dilated_min(clamp_row(y - 1)), dilated_min(y), dilated_min(clamp_row(y + 1)), closed, width);
+			combine<simd>(source_row(y), opened, closed, dst + static_cast<size_t>(y) * dst_stride, width);
+		}
+	}
+};
+
+#endif // CONTRAST_KERNEL_HPP
@@ -0,0 +1,299 @@
+#ifndef FRAME_CONTEXT_HPP
+#define FRAME_CONTEXT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <opencv2/imgproc.hpp>
+#include "recognizer_metrics.hpp"
+#include "raw_frame.hpp"
+#include "contour_arena.hpp"
+
+//everything the strategies need to know about the frame they are working on
+//derived images (like grayscale) are computed lazily, at most once per frame, and shared by all of the strategies
+//the scratch buffers are kept between frames, so frames of the same size don't allocate them again
+//(cv::Mat::create() reuses memory if the size and type didn't change)
+class frame_context
+{
+private:
+	//empty for YUV frames, those have only the grayscale (Y plane)
+	cv::Mat source;
+	pixel_format source_format = pixel_format::bgr;
+
+	cv::Mat gray_image;
+	bool is_gray_ready = false;
+
+	//frames decoded from a file or a buffer: the detection grayscale is decoded at a reduced size up front,
+	//and the full resolution frame only when something asks for it (a strategy that has a candidate to crop)
+	std::function<cv::Mat()> decode_full_frame;
+	cv::Mat reduced_gray_image;
+	double reduced_gray_scale = 0;
+
+	//the grayscale points to memory of the caller (a grayscale source or the Y plane), it must never be written to
+	bool is_gray_borrowed = false;
+
+	//strategies detect plates on a (possibly) downscaled grayscale frame and crop them from the full resolution one
+	double scale = 1.0;
+	cv::Mat detection_gray_image;
+	bool is_detection_gray_ready = false;
+
+	std::map<std::string, cv::Mat> buffers;
+	std::map<std::string, contour_arena> contour_arenas;
+
+	//where the strategies record their timings, null when the metrics are disabled
+	recognizer_metrics* frame_metrics = nullptr;
+
+	//strategies may run in parallel on the same frame
+	std::mutex sync;
+
+public:
+	frame_context() = default;
+
+	explicit frame_context(const cv::Mat& image)
+	{
+		reset(image);
+	}
+
+	explicit frame_context(const raw_frame& frame)
+	{
+		reset(frame);
+	}
+
+	frame_context(const frame_context& other) = delete;
+	frame_context& operator=(const frame_context& other) = delete;
+
+	//start working on a new frame, the memory of the derived images and buffers is kept for reuse
+	//(the image is expected to be BGR, or grayscale if it has a single channel)
+	void reset(const cv::Mat& image)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		start_frame();
+		source = image;
+		source_format = image.channels() == 1 ? pixel_format::gray : image.channels() == 4 ? pixel_format::bgra : pixel_format::bgr;
+	}
+
+	//start working on a frame in memory of the caller, nothing is copied
+	//the Y plane of YUV frames *is* the grayscale, so there is no conversion at all for them
+	void reset(const raw_frame& frame)
+	{
+		frame.throw_if_invalid();
+
+		std::lock_guard<std::mutex> lock(sync);
+		start_frame();
+		source_format = frame.format;
+		if(frame.is_yuv())
+		{
+			source.release();
+			gray_image = frame.first_plane();
+			is_gray_ready = true;
+			is_gray_borrowed = true;
+		}
+		else
+			source = frame.first_plane();
+	}
+
+	//start working on a frame that is decoded lazily, 'reduced_gray' is the frame at 'reduced_scale' and
+	//'decode_full' decodes the full resolution (BGR) frame, it is called at most once and only if needed
+	void reset(const cv::Mat& reduced_gray, const double reduced_scale, std::function<cv::Mat()> decode_full)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		start_frame();
+		source.release();
+		source_format = pixel_format::bgr;
+		reduced_gray_image = reduced_gray;
+		reduced_gray_scale = reduced_scale;
+		decode_full_frame = std::move(decode_full);
+	}
+
+	//the scale the frame already has a grayscale for (without decoding or resizing anything), zero if there is none
+	double preferred_detection_scale() const { return reduced_gray_scale; }
+
+	//change the scale of the detection image (1.0 is full resolution), this invalidates the detection image
+	void set_detection_scale(const double detection_scale)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		if(detection_scale == scale)
+			return;
+
+		scale = detection_scale > 0.0 && detection_scale < 1.0 ? detection_scale : 1.0;
+		is_detection_gray_ready = false;
+	}
+
+	double detection_scale() const { return scale; }
+
+	//a length the strategies were tuned with on full resolution frames (a minimum character height, a filter radius, ...)
+	//at the detection scale, so a downscaled pass filters the same plates as a full resolution one would
+	double to_detection(const double length) const
+	{
+		return scale >= 1.0 ? length : length * scale;
+	}
+
+	//same for the (odd) size of a filter kernel, never smaller than 'min_size'
+	int to_detection_kernel(const int size, const int min_size = 3) const
+	{
+		return std::max(min_size, cvRound(to_detection(size))) | 1;
+	}
+
+	void set_metrics(recognizer_metrics* metrics) { frame_metrics = metrics; }
+	recognizer_metrics* metrics() const { return frame_metrics; }
+
+	//the original frame (empty for YUV frames), lazily decoded frames get decoded here
+	const cv::Mat& image()
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		decode_source();
+		return source;
+	}
+
+	pixel_format format() const { return source_format; }
+
+	//full resolution image the strategies should crop candidates from - the original frame, or the grayscale if there is no color
+	//(see candidate_normalization::normalize() for turning the crop into what OCR expects)
+	const cv::Mat& crop_source()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sync);
+			decode_source();
+			if(!source.empty())
+				return source;
+		}
+		return gray();
+	}
+
+	//grayscale version of the frame
+	const cv::Mat& gray()
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		if(!is_gray_ready)
+		{
+			decode_source();
+
+			//convert to grayscale so there will be less variation in image to deal with
+			switch(source_format)
+			{
+				case pixel_format::gray:
+					gray_image = source;
+					is_gray_borrowed = true;
+					break;
+				case pixel_format::rgb:
+					cv::cvtColor(source, gray_image, cv::COLOR_RGB2GRAY);
+					break;
+				case pixel_format::rgba:
+					cv::cvtColor(source, gray_image, cv::COLOR_RGBA2GRAY);
+					break;
+				case pixel_format::bgra:
+					cv::cvtColor(source, gray_image, cv::COLOR_BGRA2GRAY);
+					break;
+				default:
+					cv::cvtColor(source, gray_image, cv::COLOR_BGR2GRAY);
+					break;
+			}
+			is_gray_ready = true;
+		}
+
+		return gray_image;
+	}
+
+	//grayscale frame at the detection scale, this is what strategies should look for plates on
+	const cv::Mat& detection_gray()
+	{
+		if(scale >= 1.0)
+			return gray();
+
+		{
+			//the reduced grayscale of a lazily decoded frame is used as is, so the full frame doesn't have to be decoded for detection
+			std::lock_guard<std::mutex> lock(sync);
+			if(!is_detection_gray_ready && !reduced_gray_image.empty() && std::abs(reduced_gray_scale - scale) < 1e-9)
+			{
+				detection_gray_image = reduced_gray_image;
+				is_detection_gray_ready = true;
+			}
+
+			if(is_detection_gray_ready)
+				return detection_gray_image;
+		}
+
+		const auto& full_resolution_gray = gray();
+
+		std::lock_guard<std::mutex> lock(sync);
+		if(!is_detection_gray_ready)
+		{
+			//area interpolation averages the pixels, so thin edges survive the downscaling better than with nearest/linear
+			cv::resize(full_resolution_gray, detection_gray_image, cv::Size(), scale, scale, cv::INTER_AREA);
+			is_detection_gray_ready = true;
+		}
+
+		return detection_gray_image;
+	}
+
+	//map coordinates found on the detection image back to the full resolution frame
+	cv::Point to_source(const cv::Point& point) const
+	{
+		if(scale >= 1.0)
+			return point;
+
+		return cv::Point(cvRound(point.x / scale), cvRound(point.y / scale));
+	}
+
+	void to_source(std::vector<cv::Point>& contour) const
+	{
+		if(scale >= 1.0)
+			return;
+
+		for(auto& point : contour)
+			point = to_source(point);
+	}
+
+	//a named scratch buffer that survives between frames
+	//names should be prefixed by the strategy that uses them, since two strategies may run on the same frame at the same time
+	cv::Mat& buffer(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+
+		//references to std::map values stay valid when other values are inserted
+		return buffers[name];
+	}
+
+	//a named contour arena that survives between frames, named the same way as buffer()
+	contour_arena& contours(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		return contour_arenas[name];
+	}
+
+private:
+	//must be called with the lock held
+	void decode_source()
+	{
+		if(!source.empty() || !decode_full_frame)
+			return;
+
+		source = decode_full_frame();
+		source_format = source.channels() == 1 ? pixel_format::gray : pixel_format::bgr;
+		decode_full_frame = nullptr;
+	}
+
+	//must be called with the lock held
+	void start_frame()
+	{
+		//a borrowed grayscale would otherwise be reused as the output of the next conversion, and overwrite memory of the caller
+		if(is_gray_borrowed)
+		{
+			gray_image.release();
+			is_gray_borrowed = false;
+		}
+
+		is_gray_ready = false;
+		scale = 1.0;
+		is_detection_gray_ready = false;
+
+		decode_full_frame = nullptr;
+		reduced_gray_image.release();
+		reduced_gray_scale = 0;
+	}
+};
+
+#endif // FRAME_CONTEXT_HPP
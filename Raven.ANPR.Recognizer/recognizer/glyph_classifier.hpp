@@ -0,0 +1,186 @@
+#ifndef GLYPH_CLASSIFIER_HPP
+#define GLYPH_CLASSIFIER_HPP
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//nearest neighbour classifier of single plate characters
+//every character image is normalized into a small fixed size glyph (binarized, cropped to the ink, fitted into the glyph box
+//with its aspect ratio kept and scaled to unit length), and the label of the closest known glyph wins
+//the model is just the known glyphs - a few hundred of them, which is small enough to search by brute force
+//note: read-only after it is built, so a single instance can classify on any number of threads
+class glyph_classifier
+{
+public:
+	static constexpr int glyph_width = 12;
+	static constexpr int glyph_height = 20;
+	static constexpr int glyph_size = glyph_width * glyph_height;
+
+private:
+	//glyph_size floats per sample, one sample after another
+	std::vector<float> samples;
+	std::vector<char> labels;
+
+	static float distance(const float* a, const float* b)
+	{
+		float sum = 0;
+		for(auto i = 0; i < glyph_size; i++)
+		{
+			const auto d = a[i] - b[i];
+			sum += d * d;
+		}
+		return sum;
+	}
+
+public:
+	//characters on plates, the built-in model knows only these
+	static const std::string& plate_alphabet()
+	{
+		static const std::string alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+		return alphabet;
+	}
+
+	//turn an image of a single character (8 bit grayscale like the normalized candidates, or RGBA/BGR) into its feature vector, false if there is no ink in the image
+	//the character may be dark on light or light on dark, the minority of the pixels is taken as the ink
+	static bool normalize(const cv::Mat& char_image, std::vector<float>& features)
+	{
+		if(char_image.empty())
+			return false;
+
+		cv::Mat gray;
+		if(char_image.channels() == 4)
+			cv::cvtColor(char_image, gray, cv::COLOR_RGBA2GRAY);
+		else if(char_image.channels() == 3)
+			cv::cvtColor(char_image, gray, cv::COLOR_BGR2GRAY);
+		else
+			gray = char_image;
+
+		cv::Mat ink;
+		cv::threshold(gray, ink, 0, 255, cv::THRESH_BINARY_INV | cv::THRESH_OTSU);
+		if(cv::countNonZero(ink) * 2 > ink.rows * ink.cols)
+			cv::bitwise_not(ink, ink);
+
+		std::vector<cv::Point> ink_pixels;
+		cv::findNonZero(ink, ink_pixels);
+		if(ink_pixels.empty())
+			return false;
+
+		const auto bounds = cv::boundingRect(ink_pixels);
+		const auto scale = std::min(static_cast<double>(glyph_width) / bounds.width, static_cast<double>(glyph_height) / bounds.height);
+		const cv::Size fitted(
+			std::max(1, std::min(glyph_width, static_cast<int>(bounds.width * scale + 0.5))),
+			std::max(1, std::min(glyph_height, static_cast<int>(bounds.height * scale + 0.5))));
+
+		cv::Mat glyph = cv::Mat::zeros(glyph_height, glyph_width, CV_32F);
+		auto centered = glyph(cv::Rect((glyph_width - fitted.width) / 2, (glyph_height - fitted.height) / 2, fitted.width, fitted.height));
+		cv::Mat ink_values;
+		ink(bounds).convertTo(ink_values, CV_32F, 1.0 / 255);
+		cv::resize(ink_values, centered, fitted, 0, 0, cv::INTER_AREA);
+
+		const auto norm = cv::norm(glyph, cv::NORM_L2);
+		if(norm <= 0)
+			return false;
+
+		features.resize(glyph_size);
+		const auto* values = glyph.ptr<float>();
+		for(auto i = 0; i < glyph_size; i++)
+			features[i] = static_cast<float>(values[i] / norm);
+		return true;
+	}
+
+	void add_features(const std::vector<float>& features, const char label)
+	{
+		if(features.size() != glyph_size)
+			throw std::invalid_argument("Glyph features have the wrong size");
+
+		samples.insert(samples.end(), features.begin(), features.end());
+		labels.push_back(label);
+	}
+
+	//teach the classifier a character, images without any ink are ignored
+	void add_sample(const cv::Mat& char_image, const char label)
+	{
+		std::vector<float> features;
+		if(normalize(char_image, features))
+			add_features(features, label);
+	}
+
+	//label of the nearest known glyph, and a confidence (0-100) from how much closer it is than the nearest glyph of any other label
+	//(a glyph halfway between an '8' and a 'B' gets close to zero, even if it is near both of them)
+	bool classify(const std::vector<float>& features, char& label, int& confidence) const
+	{
+		if(labels.empty() || features.size() != glyph_size)
+			return false;
+
+		auto best = std::numeric_limits<float>::max();
+		size_t best_index = 0;
+		for(size_t i = 0; i < labels.size(); i++)
+		{
+			const auto d = distance(features.data(), &samples[i * glyph_size]);
+			if(d < best)
+			{
+				best = d;
+				best_index = i;
+			}
+		}
+
+		label = labels[best_index];
+
+		auto runner_up = std::numeric_limits<float>::max();
+		for(size_t i = 0; i < labels.size(); i++)
+			if(labels[i] != label)
+				runner_up = std::min(runner_up, distance(features.data(), &samples[i * glyph_size]));
+
+		confidence = runner_up == std::numeric_limits<float>::max() || runner_up <= 0
+			? 100
+			: static_cast<int>(100.0 * std::max(0.0, 1.0 - std::sqrt(best / runner_up)) + 0.5);
+		return true;
+	}
+
+	bool classify(const cv::Mat& char_image, char& label, int& confidence) const
+	{
+		std::vector<float> features;
+		return normalize(char_image, features) && classify(features, label, confidence);
+	}
+
+	size_t size() const { return labels.size(); }
+
+	//the built-in model - the plate alphabet rendered with the Hershey fonts at a few stroke widths
+	//good enough for plates in a plain sans font, for anything else train on real crops with add_sample()
+	static glyph_classifier with_rendered_glyphs()
+	{
+		glyph_classifier classifier;
+
+		const int fonts[] = { cv::FONT_HERSHEY_SIMPLEX, cv::FONT_HERSHEY_DUPLEX, cv::FONT_HERSHEY_COMPLEX, cv::FONT_HERSHEY_TRIPLEX };
+		const int thicknesses[] = { 2, 3, 5 };
+
+		cv::Mat canvas;
+		for(const auto c : plate_alphabet())
+		{
+			const std::string text(1, c);
+			for(const auto font : fonts)
+			{
+				for(const auto thickness : thicknesses)
+				{
+					int baseline = 0;
+					const auto size = cv::getTextSize(text, font, 2.0, thickness, &baseline);
+
+					canvas.create(size.height + baseline + 2 * thickness, size.width + 2 * thickness, CV_8U);
+					canvas.setTo(cv::Scalar(255));
+					cv::putText(canvas, text, cv::Point(thickness, size.height + thickness), font, 2.0, cv::Scalar(0), thickness, cv::LINE_AA);
+
+					classifier.add_sample(canvas, c);
+				}
+			}
+		}
+
+		return classifier;
+	}
+};
+
+#endif // GLYPH_CLASSIFIER_HPP
@@ -5,10 +5,12 @@
 #include <opencv2/core/mat.hpp>
 #include <opencv2/imgproc.hpp>
 #include <corecrt_math_defines.h>
+#include "contour_arena.hpp"
 
 struct if_char
 {
-	std::vector<cv::Point> contour;
+	//points of the contour in the frame's contour_arena, only looked at and never copied
+	contour_view contour;
 	cv::Rect bounding_rect;
 
 	double center_x() const { return static_cast<double>(bounding_rect.x + bounding_rect.x + bounding_rect.width) / 2.0; }
@@ -17,8 +19,6 @@ struct if_char
 	double diagonal_size() const { return sqrt(pow(bounding_rect.width, 2) + pow(bounding_rect.height, 2)); }
 	double aspect_ratio() const { return static_cast<float>(bounding_rect.width) / static_cast<float>(bounding_rect.height); }
 
-	operator std::vector<cv::Point>() const { return contour; }
-
 	double angle_to(const if_char& other) const
 	{
 		const auto adjacent = float(abs(center_x() - other.center_x()));
@@ -38,12 +38,11 @@ struct if_char
 
 	if_char() = default;
 
-	//since this is not defined as 'explicit', this converts the 'vector<Point>' to 'if_char'
-	//just like implicit operator converters work in C#
-	if_char(const std::vector<cv::Point>& contour) 
+	//the points stay where they are, so the char is valid only as long as the contour's storage
+	explicit if_char(const contour_view& contour)
 		: contour(contour)
 	{
-		bounding_rect = cv::boundingRect(contour);
+		bounding_rect = cv::boundingRect(contour.as_mat());
 	}
 
 	if_char(const if_char& other) = default;
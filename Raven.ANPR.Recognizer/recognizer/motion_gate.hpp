@@ -0,0 +1,265 @@
+#ifndef MOTION_GATE_HPP
+#define MOTION_GATE_HPP
+
+#include <opencv2/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "raw_frame.hpp"
+
+//tuning knobs of motion_gate
+struct motion_gate_options
+{
+	//the frames are compared at this width (never upscaled), it only has to be big enough to see a vehicle
+	int analysis_width = 320;
+
+	//a pixel has changed if it differs from the background by more than this (0-255)
+	double pixel_threshold = 25;
+
+	//how fast the background follows the scene (0-1), a vehicle that stops becomes background after roughly 1 / background_rate frames
+	double background_rate = 0.05;
+
+	//changed blobs with fewer pixels than this (at the analysis width) are noise, like leaves or compression artifacts
+	int min_blob_pixels = 24;
+
+	//changed regions are grown by this fraction of their size on every side, the plate is often at the edge of a moving vehicle
+	double region_margin = 0.25;
+
+	//if the changed regions cover more than this fraction of the frame, detection runs once on their bounding box instead
+	double max_region_fraction = 0.5;
+
+	//lane/ROI polygons in frame coordinates, changes outside of them are ignored - no polygons means the whole frame
+	std::vector<std::vector<cv::Point>> regions_of_interest;
+
+	//run detection on the whole ROI once in this many frames without any change, zero means never
+	size_t refresh_interval = 0;
+};
+
+//counters of the gate, mostly to see how much detection it saves
+struct motion_gate_stats
+{
+	size_t frames = 0;
+
+	//frames where nothing relevant changed, detection can skip them entirely
+	size_t static_frames = 0;
+};
+
+//cheap change detection in front of the plate finder strategies, for a single camera
+//a running average of the (downscaled grayscale) frames is the background, and the parts of a frame that differ from it
+//(and fall into a region of interest) are the only places where a new plate can show up
+//note: not thread-safe and it keeps state between frames, use one instance per camera
+class motion_gate
+{
+private:
+	motion_gate_options options;
+	motion_gate_stats stats;
+
+	cv::Size frame_size;
+	double analysis_scale = 1.0;
+	cv::Rect roi_bounds;
+	cv::Mat roi_mask;
+
+	//CV_32F, empty until the first frame
+	cv::Mat background;
+
+	cv::Mat small_color;
+	cv::Mat small_gray;
+	cv::Mat background_gray;
+	cv::Mat changed;
+	cv::Mat labels, blob_stats, centroids;
+
+	size_t frames_without_change = 0;
+
+	//a new camera resolution (or the first frame), the model starts over
+	void start_over(const cv::Size& size)
+	{
+		frame_size = size;
+		background.release();
+		frames_without_change = 0;
+
+		analysis_scale = std::min(1.0, static_cast<double>(options.analysis_width) / size.width);
+		const cv::Size analysis_size(
+			std::max(1, static_cast<int>(std::lround(size.width * analysis_scale))),
+			std::max(1, static_cast<int>(std::lround(size.height * analysis_scale))));
+
+		const cv::Rect frame_bounds(0, 0, size.width, size.height);
+		if(options.regions_of_interest.empty())
+		{
+			roi_bounds = frame_bounds;
+			roi_mask = cv::Mat(analysis_size, CV_8UC1, cv::Scalar(255));
+			return;
+		}
+
+		roi_bounds = cv::Rect();
+		roi_mask = cv::Mat::zeros(analysis_size, CV_8UC1);
+		for(const auto& polygon : options.regions_of_interest)
+		{
+			if(polygon.empty())
+				continue;
+
+			roi_bounds |= cv::boundingRect(polygon);
+
+			std::vector<cv::Point> scaled;
+			for(const auto& point : polygon)
+				scaled.emplace_back(static_cast<int>(std::lround(point.x * analysis_scale)), static_cast<int>(std::lround(point.y * analysis_scale)));
+			cv::fillPoly(roi_mask, std::vector<std::vector<cv::Point>> { scaled }, cv::Scalar(255));
+		}
+		roi_bounds &= frame_bounds;
+	}
+
+	//blobs of 'changed' in frame coordinates, grown by the margin and clipped to the ROI
+	void collect_changed_regions(std::vector<cv::Rect>& changed_regions)
+	{
+		const auto blob_count = cv::connectedComponentsWithStats(changed, labels, blob_stats, centroids, 8, CV_32S);
+		for(auto i = 1; i < blob_count; i++)
+		{
+			if(blob_stats.at<int>(i, cv::CC_STAT_AREA) < options.min_blob_pixels)
+				continue;
+
+			const auto left = blob_stats.at<int>(i, cv::CC_STAT_LEFT) / analysis_scale;
+			const auto top = blob_stats.at<int>(i, cv::CC_STAT_TOP) / analysis_scale;
+			const auto width = blob_stats.at<int>(i, cv::CC_STAT_WIDTH) / analysis_scale;
+			const auto height = blob_stats.at<int>(i, cv::CC_STAT_HEIGHT) / analysis_scale;
+			const auto margin_x = width * options.region_margin;
+			const auto margin_y = height * options.region_margin;
+
+			const auto region = cv::Rect(
+				cv::Point(static_cast<int>(std::floor(left - margin_x)), static_cast<int>(std::floor(top - margin_y))),
+				cv::Point(static_cast<int>(std::ceil(left + width + margin_x)), static_cast<int>(std::ceil(top + height + margin_y)))) & roi_bounds;
+
+			if(region.area() > 0)
+				changed_regions.push_back(region);
+		}
+
+		//the grown regions of one vehicle tend to overlap, merge them so detection doesn't look at the same pixels twice
+		for(auto merged = true; merged; )
+		{
+			merged = false;
+			for(size_t i = 0; i < changed_regions.size() && !merged; i++)
+			{
+				for(size_t j = i + 1; j < changed_regions.size(); j++)
+				{
+					if((changed_regions[i] & changed_regions[j]).area() == 0)
+						continue;
+
+					changed_regions[i] |= changed_regions[j];
+					changed_regions.erase(changed_regions.begin() + static_cast<std::ptrdiff_t>(j));
+					merged = true;
+					break;
+				}
+			}
+		}
+
+		double total_area = 0;
+		for(const auto& region : changed_regions)
+			total_area += region.area();
+
+		if(changed_regions.size() > 1 && total_area > options.max_region_fraction * frame_size.area())
+		{
+			cv::Rect bounds = changed_regions.front();
+			for(const auto& region : changed_regions)
+				bounds |= region;
+			changed_regions.assign(1, bounds);
+		}
+	}
+
+public:
+	explicit motion_gate(const motion_gate_options& options = motion_gate_options())
+		: options(options)
+	{
+	}
+
+	//feed the next frame of the camera, 'changed_regions' gets the parts of it (in frame coordinates) detection should look at
+	//false if nothing relevant changed, detection can skip the frame (the very first frame always counts as changed)
+	bool update(const cv::Mat& image, const pixel_format format, std::vector<cv::Rect>& changed_regions)
+	{
+		changed_regions.clear();
+		if(image.empty())
+			return false;
+
+		stats.frames++;
+		if(image.size() != frame_size)
+			start_over(image.size());
+
+		//scale down before converting to grayscale, so the conversion works on a fraction of the pixels
+		if(image.channels() == 1)
+			cv::resize(image, small_gray, roi_mask.size(), 0, 0, cv::INTER_AREA);
+		else
+		{
+			cv::resize(image, small_color, roi_mask.size(), 0, 0, cv::INTER_AREA);
+			switch(format)
+			{
+				case pixel_format::rgb:
+					cv::cvtColor(small_color, small_gray, cv::COLOR_RGB2GRAY);
+					break;
+				case pixel_format::rgba:
+					cv::cvtColor(small_color, small_gray, cv::COLOR_RGBA2GRAY);
+					break;
+				case pixel_format::bgra:
+					cv::cvtColor(small_color, small_gray, cv::COLOR_BGRA2GRAY);
+					break;
+				default:
+					cv::cvtColor(small_color, small_gray, cv::COLOR_BGR2GRAY);
+					break;
+			}
+		}
+
+		if(background.empty())
+		{
+			small_gray.convertTo(background, CV_32F);
+			changed_regions.push_back(roi_bounds);
+			return true;
+		}
+
+		background.convertTo(background_gray, CV_8U);
+		cv::absdiff(small_gray, background_gray, changed);
+		cv::threshold(changed, changed, options.pixel_threshold, 255, cv::THRESH_BINARY);
+		cv::bitwise_and(changed, roi_mask, changed);
+		cv::accumulateWeighted(small_gray, background, options.background_rate);
+
+		//a vehicle rarely differs from the road everywhere, closing the gaps keeps it in one piece
+		cv::dilate(changed, changed, cv::Mat(), cv::Point(-1, -1), 2);
+		collect_changed_regions(changed_regions);
+
+		if(!changed_regions.empty())
+		{
+			frames_without_change = 0;
+			return true;
+		}
+
+		if(options.refresh_interval > 0 && ++frames_without_change >= options.refresh_interval)
+		{
+			frames_without_change = 0;
+			changed_regions.push_back(roi_bounds);
+			return true;
+		}
+
+		stats.static_frames++;
+		return false;
+	}
+
+	//the image is expected to be BGR, or grayscale if it has a single channel (just like frame_context::reset())
+	bool update(const cv::Mat& image, std::vector<cv::Rect>& changed_regions)
+	{
+		return update(image, image.channels() == 1 ? pixel_format::gray : image.channels() == 4 ? pixel_format::bgra : pixel_format::bgr, changed_regions);
+	}
+
+	//the same for a frame in memory of the caller, YUV frames are compared by their Y plane
+	bool update(const raw_frame& frame, std::vector<cv::Rect>& changed_regions)
+	{
+		frame.throw_if_invalid();
+		return update(frame.first_plane(), frame.is_yuv() ? pixel_format::gray : frame.format, changed_regions);
+	}
+
+	//forget the background, for example when the camera has been moved
+	void reset()
+	{
+		frame_size = cv::Size();
+		background.release();
+		frames_without_change = 0;
+	}
+
+	const motion_gate_stats& statistics() const { return stats; }
+};
+
+#endif // MOTION_GATE_HPP
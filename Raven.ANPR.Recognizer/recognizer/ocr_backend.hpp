@@ -0,0 +1,33 @@
+#ifndef OCR_BACKEND_HPP
+#define OCR_BACKEND_HPP
+
+#include <string>
+#include <vector>
+#include "plate_candidate.hpp"
+
+//outcome of OCR on a single plate candidate
+struct ocr_read
+{
+	std::string text;
+	int confidence = 0;
+	bool succeeded = false;
+
+	//confidence (0-100) of each character of 'text', empty if the engine doesn't report it
+	std::vector<int> char_confidences;
+};
+
+//something that turns a cropped plate into text - tesseract, the per-character classifier, or a chain of those
+//plate_recognizer calls it concurrently for different candidates, so implementations have to be thread-safe
+class ocr_backend
+{
+public:
+	virtual ~ocr_backend() = default;
+
+	//'read' starts out empty, the return value is the same as read.succeeded
+	virtual bool try_read(const plate_candidate& candidate, ocr_read& read) = 0;
+
+	//how many reads can run at the same time without waiting on each other, plate_recognizer sizes its OCR workers by this
+	virtual size_t concurrency() const = 0;
+};
+
+#endif // OCR_BACKEND_HPP
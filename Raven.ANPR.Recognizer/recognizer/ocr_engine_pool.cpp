@@ -0,0 +1,100 @@
+#include "ocr_engine_pool.h"
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+std::unique_ptr<tesseract::TessBaseAPI> ocr_engine_pool::create_engine()
+{
+	//note: tesseract requires data directory for it to work properly where the executable works
+	//by default, the directory is 'tessdata' and it should contain files like 'eng.traineddata' per each language that is used with it.
+	//without the directory and some training files, tesseract api will fail to initialize
+	auto engine = std::make_unique<tesseract::TessBaseAPI>();
+
+	engine->SetVariable("load_system_dawg", "0");
+	engine->SetVariable("load_freq_dawg", "0");
+	engine->SetVariable("load_punc_dawg", "0");
+	engine->SetVariable("load_number_dawg", "0");
+	engine->SetVariable("load_unambig_dawg", "0");
+	engine->SetVariable("load_bigram_dawg", "0");
+	engine->SetVariable("load_fixed_length_dawgs", "0");
+
+	if (engine->Init(nullptr, "eng", tesseract::OEM_TESSERACT_LSTM_COMBINED) == -1)
+		throw std::runtime_error("Failed to initialize tesseract");
+
+	engine->SetPageSegMode(tesseract::PageSegMode::PSM_SINGLE_WORD);
+
+	return engine;
+}
+
+ocr_engine_pool::ocr_engine_pool(size_t pool_size)
+{
+	if(pool_size == 0)
+		pool_size = std::max(1u, std::thread::hardware_concurrency());
+
+	capacity = pool_size;
+	engines.reserve(pool_size);
+	available_engines.reserve(pool_size);
+
+	//one engine right away, so a missing tessdata directory fails the construction and not the first OCR
+	engines.push_back(create_engine());
+	available_engines.push_back(engines.back().get());
+	engines_created = 1;
+}
+
+ocr_engine_pool::~ocr_engine_pool()
+{
+	for(auto& engine : engines)
+		engine->End();
+}
+
+ocr_engine_pool::lease ocr_engine_pool::acquire()
+{
+	std::unique_lock<std::mutex> lock(sync);
+	engine_released.wait(lock, [this] { return !available_engines.empty() || engines_created < capacity; });
+
+	if(!available_engines.empty())
+	{
+		const auto engine = available_engines.back();
+		available_engines.pop_back();
+
+		return lease(this, engine);
+	}
+
+	//every engine is busy but there is room for another one, the slot is taken before the lock is released
+	//so that concurrent checkouts don't create more engines than the pool size
+	engines_created++;
+	lock.unlock();
+
+	std::unique_ptr<tesseract::TessBaseAPI> engine;
+	try
+	{
+		engine = create_engine();
+	}
+	catch(...)
+	{
+		lock.lock();
+		engines_created--;
+		lock.unlock();
+		engine_released.notify_one();
+		throw;
+	}
+
+	lock.lock();
+	engines.push_back(std::move(engine));
+	return lease(this, engines.back().get());
+}
+
+size_t ocr_engine_pool::created_count()
+{
+	std::lock_guard<std::mutex> lock(sync);
+	return engines.size();
+}
+
+void ocr_engine_pool::release(tesseract::TessBaseAPI* engine)
+{
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		available_engines.push_back(engine);
+	}
+	engine_released.notify_one();
+}
@@ -0,0 +1,98 @@
+#ifndef OCR_ENGINE_POOL_H
+#define OCR_ENGINE_POOL_H
+
+#include <tesseract/baseapi.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//a bounded set of tesseract engines
+//a single TessBaseAPI instance can OCR only one image at a time, so each thread that wants to OCR something
+//checks out its own engine and the engine goes back to the pool once the lease is destroyed
+//an engine takes a while to initialize and holds its own copy of the language model (tens of MB), so only the first one
+//is created up front - the others are created when a checkout finds every existing engine busy, up to the pool size
+class ocr_engine_pool
+{
+private:
+	size_t capacity;
+	std::vector<std::unique_ptr<tesseract::TessBaseAPI>> engines;
+	std::vector<tesseract::TessBaseAPI*> available_engines;
+
+	//engines that exist or are being initialized right now (without the lock held)
+	size_t engines_created = 0;
+
+	std::mutex sync;
+	std::condition_variable engine_released;
+
+	static std::unique_ptr<tesseract::TessBaseAPI> create_engine();
+	void release(tesseract::TessBaseAPI* engine);
+
+public:
+	//RAII handle of a checked out engine, returns the engine to the pool when it goes out of scope
+	class lease
+	{
+	private:
+		ocr_engine_pool* pool;
+		tesseract::TessBaseAPI* engine;
+
+	public:
+		lease(ocr_engine_pool* pool, tesseract::TessBaseAPI* engine)
+			: pool(pool),
+			  engine(engine)
+		{
+		}
+
+		lease(const lease& other) = delete;
+		lease& operator=(const lease& other) = delete;
+
+		lease(lease&& other) noexcept
+			: pool(other.pool),
+			  engine(other.engine)
+		{
+			other.pool = nullptr;
+			other.engine = nullptr;
+		}
+
+		lease& operator=(lease&& other) noexcept
+		{
+			if (this == &other)
+				return *this;
+			if (pool != nullptr)
+				pool->release(engine);
+			pool = other.pool;
+			engine = other.engine;
+			other.pool = nullptr;
+			other.engine = nullptr;
+			return *this;
+		}
+
+		~lease()
+		{
+			if (pool != nullptr)
+				pool->release(engine);
+		}
+
+		tesseract::TessBaseAPI& operator*() const { return *engine; }
+		tesseract::TessBaseAPI* operator->() const { return engine; }
+	};
+
+	//pool_size is the most engines the pool will ever create, zero means "one engine per hardware thread"
+	explicit ocr_engine_pool(size_t pool_size = 0);
+
+	ocr_engine_pool(const ocr_engine_pool& other) = delete;
+	ocr_engine_pool& operator=(const ocr_engine_pool& other) = delete;
+
+	~ocr_engine_pool();
+
+	//takes an idle engine, creates a new one if there is none and the pool is not full yet, otherwise blocks until one is released
+	lease acquire();
+
+	//how many engines can be checked out at the same time
+	size_t size() const { return capacity; }
+
+	//how many engines were actually created so far
+	size_t created_count();
+};
+
+#endif // OCR_ENGINE_POOL_H
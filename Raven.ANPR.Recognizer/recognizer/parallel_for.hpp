@@ -0,0 +1,67 @@
+#ifndef PARALLEL_FOR_HPP
+#define PARALLEL_FOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <vector>
+
+//run 'action(i)' for every i in [0, count) using at most 'max_workers' threads
+//the calling thread is one of the workers, so with a single worker (or a single item) nothing is spawned at all
+//exceptions thrown by 'action' are propagated to the caller after all workers are done
+template<typename TAction>
+void parallel_for(const size_t count, size_t max_workers, TAction&& action)
+{
+	if(count == 0)
+		return;
+
+	max_workers = std::max<size_t>(1, std::min(max_workers, count));
+	if(max_workers == 1)
+	{
+		for(size_t i = 0; i < count; i++)
+			action(i);
+		return;
+	}
+
+	//workers pull the next index from a shared counter, this way slow items don't stall the rest of the work
+	std::atomic<size_t> next_index(0);
+	const auto worker = [&]
+	{
+		for(auto i = next_index++; i < count; i = next_index++)
+			action(i);
+	};
+
+	std::vector<std::future<void>> workers;
+	workers.reserve(max_workers - 1);
+	for(size_t i = 0; i < max_workers - 1; i++)
+		workers.push_back(std::async(std::launch::async, worker));
+
+	std::exception_ptr error;
+	try
+	{
+		worker();
+	}
+	catch(...)
+	{
+		error = std::current_exception();
+	}
+
+	for(auto& w : workers)
+	{
+		try
+		{
+			w.get();
+		}
+		catch(...)
+		{
+			if(!error)
+				error = std::current_exception();
+		}
+	}
+
+	if(error)
+		std::rethrow_exception(error);
+}
+
+#endif // PARALLEL_FOR_HPP
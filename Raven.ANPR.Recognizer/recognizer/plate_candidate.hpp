@@ -0,0 +1,24 @@
+#ifndef PLATE_CANDIDATE_HPP
+#define PLATE_CANDIDATE_HPP
+
+#include <opencv2/core.hpp>
+#include <vector>
+
+//a part of the image that a strategy suspects to be a license plate
+struct plate_candidate
+{
+	//cropped (and possibly de-skewed) plate, ready to be sent to OCR
+	cv::Mat image;
+
+	//where in the source image the plate was found
+	cv::Rect region;
+
+	//index of the strategy that found the plate, in the order the strategies were given to plate_recognizer
+	size_t strategy_index = 0;
+
+	//boxes of the plate's characters in 'image', from left to right
+	//filled in only by strategies that find the plate through its characters, empty otherwise
+	std::vector<cv::Rect> characters;
+};
+
+#endif // PLATE_CANDIDATE_HPP
@@ -3,7 +3,11 @@
 #include "base_plate_finder_strategy.hpp"
 #include <opencv2/imgcodecs.hpp>
 #include <map>
+#include <set>
+#include <limits>
 #include "if_char.hpp"
+#include "char_grid.hpp"
+#include "contrast_kernel.hpp"
 #include <corecrt_math_defines.h>
 #include "possible_plate.hpp"
 #include "plate_finder_by_rectangle.hpp"
@@ -12,36 +16,49 @@
 class plate_finder_by_geometry final : public base_plate_finder_strategy
 {
 private:
+	//find all characters that are close geometrically to 'possible_chars[char_index]' (distance, angle and size)
+	//only characters in the grid cells around it are compared, the matches are in the order of 'possible_chars'
 	static void find_matching_chars(
-		const if_char& possible_c,
-		const std::vector<std::vector<cv::Point>>& possible_chars, 
-		std::vector<std::vector<cv::Point>>& matching_chars)
+		const size_t char_index,
+		const std::vector<if_char>& possible_chars, 
+		const char_grid& grid,
+		std::vector<size_t>& neighbours,
+		std::vector<size_t>& matching_chars)
 	{
-		for(auto& possible_matching_char : possible_chars)
+		const auto& possible_c = possible_chars[char_index];
+		const auto max_distance = possible_c.diagonal_size() * 5;
+
+		grid.query(possible_c.center_x(), possible_c.center_y(), max_distance, neighbours);
+
+		for(const auto neighbour_index : neighbours)
 		{
-			if(possible_matching_char == possible_c)
+			const auto& possible_matching_char = possible_chars[neighbour_index];
+
+			//identical contours are the same character
+			if(neighbour_index == char_index ||
+				(possible_matching_char.bounding_rect == possible_c.bounding_rect && possible_matching_char == possible_c))
+				continue;
+
+			//the size checks are the cheapest and reject the most, so they go first
+			const auto& bounding_rect = possible_matching_char.bounding_rect;
+			const auto change_in_height = float(abs(bounding_rect.height - possible_c.bounding_rect.height)) /
+										float(possible_c.bounding_rect.height);
+			if(change_in_height >= 0.095)
 				continue;
 
-			const auto distance = possible_c.distance_to(possible_matching_char);
-			const auto angle = possible_c.angle_to(possible_matching_char);
-			
-			const auto bounding_rect = cv::boundingRect(possible_matching_char);
 			const auto change_in_area = float(abs(bounding_rect.area() - possible_c.bounding_rect.area())) /
 										float(possible_c.bounding_rect.area());
 			const auto change_in_width = float(abs(bounding_rect.width - possible_c.bounding_rect.width)) /
 										float(possible_c.bounding_rect.width);
-			const auto change_in_height = float(abs(bounding_rect.height - possible_c.bounding_rect.height)) /
-										float(possible_c.bounding_rect.height);
+			if(change_in_area >= 0.4 || change_in_width >= 0.4)
+				continue;
+
+			const auto distance = possible_c.distance_to(possible_matching_char);
+			const auto angle = possible_c.angle_to(possible_matching_char);
 
 			//if this can be a match, add to result list
-			if(distance < possible_c.diagonal_size() * 5 &&
-				angle < 10.0 &&
-				change_in_area < 0.4 &&
-				change_in_width < 0.4 &&
-				change_in_height < 0.095)
-			{
-				matching_chars.push_back(possible_matching_char);
-			}
+			if(distance < max_distance && angle < 10.0)
+				matching_chars.push_back(neighbour_index);
 		}		
 	}
 
@@ -72,62 +89,59 @@ public:
 	}
 
 	//do image manipulations that are needed to find better, more complete contours of shapes on the image
-	void prepare_image_and_find_edges(const cv::Mat& image, std::vector<std::vector<cv::Point>>& contours) const
+	void prepare_image_and_find_edges(frame_context& frame, contour_arena& contours) const
 	{
-		cv::Mat gray;
-
-		//convert to grayscale so there will be less variation in image to deal with
-		cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
-
-		const auto kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Point(3, 3));
-
-		cv::Mat topHat;
-		cv::morphologyEx(gray, topHat, cv::MORPH_TOPHAT, kernel);
-
-		cv::Mat blackHat;
-		cv::morphologyEx(gray, blackHat, cv::MORPH_BLACKHAT, kernel);
-
-		cv::Mat add;
-		cv::add(gray, topHat, add);
-
-		cv::Mat substract;
-		cv::subtract(add, blackHat, substract);
-
-		cv::Mat blur;
-		cv::GaussianBlur(substract, blur, cv::Size(5,5),0);
+		//grayscale is shared with other strategies, so it is computed only once per frame
+		//(and it may be downscaled, plate positions are mapped back to full resolution before cropping)
+		const auto& gray = frame.detection_gray();
+
+		//gray + tophat - blackhat (3x3) in a single pass over the rows, instead of four full frame passes (see contrast_kernel)
+		auto& enhanced = frame.buffer("geometry.enhanced");
+		contrast_kernel::apply(gray, enhanced, frame.buffer("geometry.enhanced_rows"));
+
+		//the filter sizes were tuned on full resolution frames, so they shrink with the detection image
+		//(the 3x3 contrast kernel above is already the smallest there is)
+		auto& blur = frame.buffer("geometry.blur");
+		const auto blur_size = frame.to_detection_kernel(5);
+		cv::GaussianBlur(enhanced, blur, cv::Size(blur_size, blur_size), 0);
 		
-		cv::Mat thresh;
-		cv::adaptiveThreshold(blur, thresh, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY_INV, 19, 9);
+		auto& thresh = frame.buffer("geometry.thresh");
+		cv::adaptiveThreshold(blur, thresh, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY_INV, frame.to_detection_kernel(19), 9);
 
-		std::vector<cv::Vec4i> hierarchy;
-		cv::findContours(thresh, contours, hierarchy, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+		contours.find_contours(thresh, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
 	}
 
 	//iterate through all found contours and 
 	//eliminate all those where shapes are too far from each others or not align properly
 	//(for example, if several shapes are too far off or if the bounding shape is in incorrect aspect ratio,
 	//this means we want to ignore those shapes as they are unlikely form a license plate)
+	//'scale' is the scale of the detection image the contours were found on, the size limits of a character are scaled with it
 	static void eliminate_irrelevant_contours_first_pass(
-		const cv::Mat& image, 
-		const std::vector<std::vector<cv::Point>>& contours, 
-		std::vector<std::vector<cv::Point>>& possible_chars)
+		const contour_arena& contours, 
+		std::vector<if_char>& possible_chars,
+		const double scale = 1.0)
 	{
 		int count_of_possible_chars = 0;
 
 		int i = 0;
 
+		const auto min_area = 80 * scale * scale;
+		const auto min_width = 2 * scale;
+		const auto min_height = 8 * scale;
+
 		//do a rough check on a contour to see if it could be a char
-		const auto check_if_char = [](const if_char& maybe_char)
+		const auto check_if_char = [&](const if_char& maybe_char)
 		{
-			return maybe_char.bounding_rect.area() > 80 &&
-				maybe_char.bounding_rect.width > 2 &&
-				maybe_char.bounding_rect.height > 8 &&
+			return maybe_char.bounding_rect.area() > min_area &&
+				maybe_char.bounding_rect.width > min_width &&
+				maybe_char.bounding_rect.height > min_height &&
 				(0.35 < maybe_char.aspect_ratio() < 1.05);
 		};
 
-		for(const auto& contour : contours)
+		//the chars only point to their contours in the arena, no points are copied
+		for(size_t contour_index = 0; contour_index < contours.size(); contour_index++)
 		{
-			auto maybe_char = if_char(contour);
+			const if_char maybe_char(contours[contour_index]);
 			
 			//if the character passes the heuristic checks we save it for next phase
 			if(check_if_char(maybe_char)) 
@@ -140,85 +154,173 @@ public:
 
 	//group shapes into sequences by using geometrical differences as thresholds as heuristics
 	//meaning: for each suspected character contour, find all others that are close geometrically to it (distance, angle)
+	//the sequences are lists of indexes into 'possible_chars'
 	static void group_contours_to_sequences_second_pass(
-		const std::vector<std::vector<cv::Point>>& possible_chars, 
-		std::vector<std::vector<std::vector<cv::Point>>>& list_of_list_of_matching_chars)
+		const std::vector<if_char>& possible_chars, 
+		std::vector<std::vector<size_t>>& list_of_list_of_matching_chars)
 	{
+		if(possible_chars.empty())
+			return;
+
+		//the search radius of each character is 5 diagonals, so a cell of about that size means only the adjacent cells are visited
+		double total_diagonal = 0.0;
 		for(const auto& possible_c : possible_chars)
+			total_diagonal += possible_c.diagonal_size();
+
+		char_grid grid;
+		grid.build(possible_chars, total_diagonal / possible_chars.size() * 5);
+
+		std::set<std::vector<size_t>> unique_sequences;
+		std::vector<size_t> neighbours;
+		for(size_t char_index = 0; char_index < possible_chars.size(); char_index++)
 		{		
-			std::vector<std::vector<cv::Point>> list_of_matching_chars;
+			std::vector<size_t> list_of_matching_chars;
 
-			//do the "cross product" comparisons of 'possible_c' with all other contours to find the sequence of all those
-			//that are close to it
-			find_matching_chars(possible_c, possible_chars, list_of_matching_chars);
+			//compare 'possible_c' with all nearby contours to find the sequence of all those that are close to it
+			find_matching_chars(char_index, possible_chars, grid, neighbours, list_of_matching_chars);
 
-			list_of_matching_chars.push_back(possible_c);
+			list_of_matching_chars.push_back(char_index);
 
 			//in this case ignore because there is not enough characters for a license plate
 			//TODO: make this configurable? I think more than 3 characters in license plate makes sense, but who knows...
 			if(list_of_matching_chars.size() < 3)
 				continue;
 
-			list_of_list_of_matching_chars.push_back(list_of_matching_chars);
+			//every character of a plate usually finds the same neighbours, so a 7 character plate would come up 7 times
+			//treating the sequence as a set makes those duplicates identical, and only the first one is kept
+			std::sort(list_of_matching_chars.begin(), list_of_matching_chars.end());
+			if(!unique_sequences.insert(list_of_matching_chars).second)
+				continue;
+
+			list_of_list_of_matching_chars.push_back(std::move(list_of_matching_chars));
 		}
 	}
 
+	//affine transform from the source image to the de-skewed crop of the plate
+	static cv::Mat plate_transform(const possible_plate& plate)
+	{
+		//Calculate how much we should rotate the cropped image. This increases the likelihood of OCR to give accurate results
+		auto rotation_matrix = cv::getRotationMatrix2D(plate.center, plate.angle, 1.0);
+
+		//then shift the rotated plate so its top-left corner lands on the origin of the output
+		//(the same sampling getRectSubPix() would do around the plate's center)
+		rotation_matrix.at<double>(0, 2) -= plate.center.x - (plate.width - 1) * 0.5;
+		rotation_matrix.at<double>(1, 2) -= plate.center.y - (plate.height - 1) * 0.5;
+
+		return rotation_matrix;
+	}
+
+	//rotate and crop the plate in a single warp that computes only the pixels of the plate
+	//(rotating the whole frame first and then cropping is much more expensive on big frames)
+	//'cropped' is an output buffer, its memory is reused if it already has the right size
 	static void crop_plate_candidate(
 		const cv::Mat& image, 
-		const std::vector<std::vector<std::vector<cv::Point>>>::value_type& list_of_matching_chars, 
+		const possible_plate& plate, 
 		cv::Mat& cropped)
 	{
-		//do some calculations about the supposed position of the license plate, based on location of its characters
-		const possible_plate plate(list_of_matching_chars);
+		if(plate.width <= 0 || plate.height <= 0)
+		{
+			cropped.release();
+			return;
+		}
 
-		//Calculate how much we should rotate the cropped image. This increases the likelihood of OCR to give accurate results
-		const auto rotation_matrix = cv::getRotationMatrix2D(plate.center, plate.angle, 1.0);
+		//crop the image to suspected license plate boundaries
+		cv::warpAffine(image, cropped, plate_transform(plate), cv::Size(plate.width, plate.height));
+	}
 
-		cv::Mat rotated;
-		//actually rotate the image
-		cv::warpAffine(image, rotated, rotation_matrix, cv::Size(image.rows, image.cols));
+	//boxes of the sequence's characters in the crop of 'plate', from left to right
+	//the characters were found on the detection image, 'scale' maps them to the source image first
+	static void map_characters_to_crop(
+		const std::vector<if_char>& possible_chars,
+		const std::vector<size_t>& sequence,
+		const double scale,
+		const possible_plate& plate,
+		std::vector<cv::Rect>& characters)
+	{
+		const auto transform = plate_transform(plate);
+		const auto* m = transform.ptr<double>();
+		const cv::Rect crop_bounds(0, 0, plate.width, plate.height);
 
-		//crop the image to suspected license plate boundaries
-		const auto cropped_size = cv::Size(plate.width, plate.height);
-		cv::getRectSubPix(rotated, cropped_size, plate.center, cropped);
+		for(const auto i : sequence)
+		{
+			const auto& rect = possible_chars[i].bounding_rect;
+			const double xs[] = { rect.x * scale, (rect.x + rect.width) * scale };
+			const double ys[] = { rect.y * scale, (rect.y + rect.height) * scale };
+
+			//the crop is rotated, so the box around the character is the box around its four transformed corners
+			auto min_x = std::numeric_limits<double>::max(), min_y = min_x;
+			auto max_x = std::numeric_limits<double>::lowest(), max_y = max_x;
+			for(const auto x : xs)
+			{
+				for(const auto y : ys)
+				{
+					const auto crop_x = m[0] * x + m[1] * y + m[2];
+					const auto crop_y = m[3] * x + m[4] * y + m[5];
+					min_x = std::min(min_x, crop_x);
+					max_x = std::max(max_x, crop_x);
+					min_y = std::min(min_y, crop_y);
+					max_y = std::max(max_y, crop_y);
+				}
+			}
+
+			const auto box = cv::Rect(cv::Point(cvFloor(min_x), cvFloor(min_y)), cv::Point(cvCeil(max_x), cvCeil(max_y))) & crop_bounds;
+			if(box.area() > 0)
+				characters.push_back(box);
+		}
+
+		std::sort(characters.begin(), characters.end(), [](const cv::Rect& a, const cv::Rect& b) { return a.x < b.x; });
 	}
 
-	bool try_find_and_crop_plate_number(const cv::Mat& image, std::vector<cv::Mat>& results) override
+	using base_plate_finder_strategy::try_find_and_crop_plate_number;
+
+	bool try_find_and_crop_plate_number(frame_context& frame, std::vector<plate_candidate>& results) override
 	{
-		std::vector<std::vector<cv::Point>> contours;
-		prepare_image_and_find_edges(image, contours);
+		//the arena is kept by the frame, so its memory is reused by the next frame
+		auto& contours = frame.contours("geometry.contours");
+		prepare_image_and_find_edges(frame, contours);
 
-		std::vector<std::vector<cv::Point>> possible_chars;
-		eliminate_irrelevant_contours_first_pass(image, contours, possible_chars);
+		std::vector<if_char> possible_chars;
+		eliminate_irrelevant_contours_first_pass(contours, possible_chars, frame.detection_scale());
 
-		std::vector<std::vector<std::vector<cv::Point>>> list_of_list_of_matching_chars;
+		std::vector<std::vector<size_t>> list_of_list_of_matching_chars;
 		group_contours_to_sequences_second_pass(possible_chars, list_of_list_of_matching_chars);
 
 		//obviously, if we didn't find sequences in second pass, we have nothing to do
 		if(list_of_list_of_matching_chars.empty()) 
 			return false;
-		int num = 1;
+
+		//the full resolution frame, or its grayscale when the frame has no color (like the Y plane of a YUV frame)
+		//asked for only now, a lazily decoded frame gets decoded only if there is something to crop
+		const auto& image = frame.crop_source();
+
 		for(const auto& list_of_matching_chars : list_of_list_of_matching_chars)
 		{
-			cv::Mat result;
+			stage_timer timer(frame.metrics(), recognizer_stage::crop);
+
+			//do some calculations about the supposed position of the license plate, based on location of its characters
+			//the characters were found on the detection image, but we crop from the full resolution frame
+			possible_plate plate(possible_chars, list_of_matching_chars);
+			plate.rescale(1.0 / frame.detection_scale());
+
 			//now that we have sequences of shapes that *could* represent license plate,
 			//we crop original image to include those sequences and treat them as candidates for license plates.
-			crop_plate_candidate(image, list_of_matching_chars, result);
-
+			auto& cropped = frame.buffer("geometry.crop");
+			crop_plate_candidate(image, plate, cropped);
 
 			//just in case, this shouldn't be true
-			if(result.data == nullptr ||
-				result.rows == 0 ||
-				result.cols == 0)
+			if(cropped.data == nullptr ||
+				cropped.rows == 0 ||
+				cropped.cols == 0)
 				continue;
+
+			plate_candidate result;
+			result.region = plate.bounding_rect() & cv::Rect(0, 0, image.cols, image.rows);
+
+			//the characters are already segmented, OCR backends that read character by character can use them as they are
+			map_characters_to_crop(possible_chars, list_of_matching_chars, 1.0 / frame.detection_scale(), plate, result.characters);
 			
-			//adjust color palette so tesseract OCR will have less issues
-			//(without this, the possibility of false positives is MUCH higher)
-			cv::cvtColor(result, result, cv::COLOR_BGR2RGBA); //without this Tesseract will fail it's OCR
-			std::stringstream xyz;
-			xyz << "cropped_" << num++ << ".png";
-			auto filename = xyz.str();
-			cv::imwrite(filename, result);
+			//a small 8 bit grayscale of a fixed height is what OCR gets, the buffer above is reused by the next candidate
+			candidate_normalization::normalize(cropped, frame.format(), frame.buffer("geometry.gray"), frame.buffer("geometry.resized"), result);
 
 			results.push_back(result);
 		}
@@ -3,6 +3,7 @@
 #include "base_plate_finder_strategy.hpp"
 #include <opencv2/imgcodecs.hpp>
 #include <map>
+#include <algorithm>
 
 // A simple and fast strategy - can generate lots of false positives
 // The idea: find edges, then iterate over ten largest closed contours.
@@ -45,64 +46,74 @@ public:
 		return *this;
 	}
 
-	void prepare_image_and_find_edges(const cv::Mat& image, std::vector<cv::Mat>& contours) const
+	void prepare_image_and_find_edges(frame_context& frame, contour_arena& contours) const
 	{
-		//convert to grayscale so there will be less variation in image to deal with
-		cv::Mat gray;
-		cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+		//grayscale is shared with other strategies, so it is computed only once per frame
+		//(and it may be downscaled, the contours are mapped back to full resolution before cropping)
+		const auto& gray = frame.detection_gray();
 
-		cv::Mat after_bilateral;
-		cv::bilateralFilter(gray, after_bilateral, 11, 17, 17);
+		//the neighbourhood of the filter was tuned on full resolution frames, so it shrinks with the detection image
+		auto& after_bilateral = frame.buffer("rectangle.bilateral");
+		cv::bilateralFilter(gray, after_bilateral, frame.to_detection_kernel(11), 17, frame.to_detection(17));
 
-		cv::Mat edges;
+		auto& edges = frame.buffer("rectangle.edges");
 		cv::Canny(after_bilateral, edges, 30, 200);
 
 		//find contours of shapes
-		cv::findContours(edges, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+		contours.find_contours(edges, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
 	}
 
-	void crop_plate_candidate(const cv::Mat& image, const cv::Mat& approx, cv::Mat& plate_candidate) const
+	//crop the plate bounded by 'approx', everything outside of the plate contour is blacked out
+	//only the bounding box of the plate is touched (mask included), so the cost doesn't depend on the size of the frame
+	//'plate_candidate' and 'mask' are output/scratch buffers, their memory is reused if they already have the right size
+	void crop_plate_candidate(const cv::Mat& image, const cv::Mat& approx, cv::Mat& plate_candidate, cv::Mat& mask) const
 	{
 		const auto plate_contour = static_cast<std::vector<cv::Point>>(approx);
 
-		//create the mask with which to perform the cropping
-		cv::Mat mask = cv::Mat::zeros(image.rows, image.cols, CV_8U);
+		//corners mapped back from a downscaled detection image can be rounded a pixel past the border
+		const auto plate_region = cv::boundingRect(plate_contour) & cv::Rect(0, 0, image.cols, image.rows);
+		if(plate_region.area() == 0)
+		{
+			plate_candidate.release();
+			return;
+		}
+
+		//create the mask with which to perform the cropping, in the coordinates of the plate's bounding box
+		mask.create(plate_region.size(), CV_8U);
+		mask.setTo(cv::Scalar::all(0));
 		const cv::Point* element_points[1] = { &plate_contour[0] };
 		int num_of_points = static_cast<int>(plate_contour.size());
-		cv::fillPoly(mask, element_points, &num_of_points, 1, cv::Scalar(255,255,255), cv::LINE_8);
+		cv::fillPoly(mask, element_points, &num_of_points, 1, cv::Scalar(255,255,255), cv::LINE_8, 0, -plate_region.tl());
 
 		//actually apply the mask
-		cv::Mat masked_plate;
-		cv::bitwise_and(image, image, masked_plate, mask);
-
-		//create new image based on part of the masked image bounded by the detected contour
-		plate_candidate = cv::Mat(masked_plate, cv::boundingRect(plate_contour));
+		plate_candidate.create(plate_region.size(), image.type());
+		plate_candidate.setTo(cv::Scalar::all(0));
+		image(plate_region).copyTo(plate_candidate, mask);
 	}
 
-	static void get_largest_contours(std::vector<cv::Mat>& shape_contours, int max_contours = 10)
+	//indexes of the largest contours of the arena, largest first (contours of the same area stay in the order of the arena)
+	//note: one more than 'max_contours' is taken - the loop this replaced let one extra through, and the results are tuned to that
+	static void get_largest_contours(const contour_arena& contours, std::vector<size_t>& largest_contours, int max_contours = 10)
 	{
-		std::vector<cv::Point> candidate_contour;
-		std::multimap<double, cv::Mat, std::greater<double>> contours_by_area;
-
-		//now we sort the contours by their area in descending order
-		for(auto& contour : shape_contours)
-			//inserting into this multimap sorts the key/value pairs since std::greater<double> comparator is specified
-			contours_by_area.insert(std::make_pair(cv::contourArea(contour), contour));
-		
-		shape_contours.clear();
-
-		int count = 0;
-		//now we take the 'max_contours' of largest contours, those would be candidates for being license plate shape
-		for(auto& pair : contours_by_area)
-		{
-			if(count++ > max_contours)
-				break;
+		std::vector<std::pair<double, size_t>> contours_by_area;
+		contours_by_area.reserve(contours.size());
+		for(size_t i = 0; i < contours.size(); i++)
+			contours_by_area.emplace_back(cv::contourArea(contours[i].as_mat()), i);
+
+		//only the head of the order matters, so there is no need to sort all of them
+		const auto count = std::min(contours_by_area.size(), static_cast<size_t>(std::max(0, max_contours + 1)));
+		std::partial_sort(contours_by_area.begin(), contours_by_area.begin() + count, contours_by_area.end(),
+			[](const std::pair<double, size_t>& a, const std::pair<double, size_t>& b)
+			{
+				return a.first > b.first || (a.first == b.first && a.second < b.second);
+			});
 
-			shape_contours.push_back(pair.second);
-		}
+		largest_contours.clear();
+		for(size_t i = 0; i < count; i++)
+			largest_contours.push_back(contours_by_area[i].second);
 	}
 
-	void get_encompassing_curve(const std::vector<cv::Mat>::value_type& contour, cv::Mat& approx_curve) const
+	void get_encompassing_curve(const cv::Mat& contour, cv::Mat& approx_curve) const
 	{
 		const auto peri = cv::arcLength(contour, true);
 
@@ -110,37 +121,57 @@ public:
 		cv::approxPolyDP(contour, approx_curve, poly_threshold * peri, true);
 	}
 
-	bool try_find_and_crop_plate_number(const cv::Mat& image, std::vector<cv::Mat>& results) override
+	using base_plate_finder_strategy::try_find_and_crop_plate_number;
+
+	bool try_find_and_crop_plate_number(frame_context& frame, std::vector<plate_candidate>& results) override
 	{
-		std::vector<cv::Mat> shape_contours;
+		//the arena is kept by the frame, so its memory is reused by the next frame
+		auto& shape_contours = frame.contours("rectangle.contours");
 		
 		//first prepare the image to find edges of shapes more accurately, 
 		//then find the edges, then contours
-		prepare_image_and_find_edges(image, shape_contours);
+		prepare_image_and_find_edges(frame, shape_contours);
 
 		//then get 10 largest contours (the small ones are unlikely to be a license plate)
-		get_largest_contours(shape_contours, 10);
+		std::vector<size_t> largest_contours;
+		get_largest_contours(shape_contours, largest_contours, 10);
 
 		//now we will iterate through possible license plate contours and try to find shapes that have 4 corners
 		//note that we prefer first shapes with smallest areas as they are most likely to be license plate
 		//(this is heuristics, of course, so this won't always be correct)
 		std::multimap<double, cv::Mat, std::less<double>> possible_results;
-		for (auto& contour : shape_contours)
+		for (const auto contour_index : largest_contours)
 		{
 			cv::Mat approx_curve;
-			get_encompassing_curve(contour, approx_curve);
+			get_encompassing_curve(shape_contours[contour_index].as_mat(), approx_curve);
 
 			//if our approximated contour has four points, then it may be a license plate...	
 			if (approx_curve.total() == 4)
 			{
 				//we found the right contour, so we will create a mask based on that contour to crop the image
 				//(this way only the masked part of original image remains)
-				cv::Mat result;
-				crop_plate_candidate(image, approx_curve, result);
+				//the corners were found on the detection image, but we crop from the full resolution frame
+				auto plate_corners = static_cast<std::vector<cv::Point>>(approx_curve);
+				frame.to_source(plate_corners);
+
+				//the full resolution frame, or its grayscale when the frame has no color (like the Y plane of a YUV frame)
+				//asked for only now, a lazily decoded frame gets decoded only if there is something to crop
+				const auto& image = frame.crop_source();
+
+				plate_candidate result;
+				result.region = cv::boundingRect(plate_corners) & cv::Rect(0, 0, image.cols, image.rows);
+				if(result.region.area() == 0)
+					continue;
+
+				{
+					stage_timer timer(frame.metrics(), recognizer_stage::crop);
+
+					auto& cropped = frame.buffer("rectangle.crop");
+					crop_plate_candidate(image, cv::Mat(plate_corners), cropped, frame.buffer("rectangle.mask"));
 
-				//adjust color palette so tesseract OCR will have less issues
-				//(without this, the possibility of false positives is MUCH higher)
-				cv::cvtColor(result, result, cv::COLOR_BGR2RGBA);
+					//a small 8 bit grayscale of a fixed height is what OCR gets, the buffer above is reused by the next candidate
+					candidate_normalization::normalize(cropped, frame.format(), frame.buffer("rectangle.gray"), frame.buffer("rectangle.resized"), result);
+				}
 
 				results.push_back(result);
 			}
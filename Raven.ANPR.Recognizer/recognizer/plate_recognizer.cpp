@@ -1,5 +1,15 @@
 #include "plate_recognizer.h"
-#include <regex>
+#include "tesseract_ocr_backend.h"
+#include "parallel_for.hpp"
+#include "bounded_queue.hpp"
+#include "candidate_consolidation.hpp"
+#include "common/mapped_file.h"
+#include <opencv2/imgcodecs.hpp>
+#include <future>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <unordered_map>
 
 void plate_recognizer::throw_if_invalid(const cv::Mat& image)
 {
@@ -7,98 +17,752 @@ void plate_recognizer::throw_if_invalid(const cv::Mat& image)
 		throw std::exception("Failed to load the plate image (Is the image corrupted?)");
 }
 
-bool plate_recognizer::try_execute_ocr(cv::Mat& plate_image, std::string& result, int& confidence)
+bool plate_recognizer::try_execute_ocr(tesseract::TessBaseAPI& ocr_api, const cv::Mat& plate_image, std::string& result, int& confidence)
 {
-	ocr_api.SetImage(plate_image.data, plate_image.cols, plate_image.rows, 4, 4 * plate_image.cols);
-	const auto text = std::shared_ptr<char>(ocr_api.GetUTF8Text());
-	confidence = ocr_api.MeanTextConf();
-	auto tmp = std::string(text.get());
-	if(tmp.empty())
+	ocr_read read;
+	tesseract_ocr_backend::try_execute_ocr(ocr_api, plate_image, read);
+	result.append(read.text);
+	confidence = read.confidence;
+	return read.succeeded;
+}
+
+void plate_recognizer::execute_ocr(std::vector<plate_candidate>& plate_candidates, std::vector<ocr_read>& reads) const
+{
+	reads.clear();
+	reads.resize(plate_candidates.size());
+
+	//each read goes into its own slot, so workers never touch the same memory
+	parallel_for(plate_candidates.size(), ocr->concurrency(), [&](const size_t i)
+	{
+		ocr_candidate(plate_candidates[i], reads[i]);
+	});
+}
+
+void plate_recognizer::ocr_candidate(plate_candidate& candidate, ocr_read& read) const
+{
+	{
+		stage_timer timer(stage_metrics.get(), recognizer_stage::ocr);
+		read.succeeded = ocr->try_read(candidate, read);
+	}
+
+	if(stage_metrics != nullptr)
+		stage_metrics->record_ocr(read.succeeded);
+}
+
+frame_context& plate_recognizer::thread_frame_context()
+{
+	thread_local frame_context frame;
+	return frame;
+}
+
+void plate_recognizer::find_plate_candidates(const size_t strategy_index, frame_context& frame, std::vector<plate_candidate>& candidates) const
+{
+	const auto first_candidate = candidates.size();
+
+	//the time each strategy takes is needed only by the cascade (to start with the cheap ones) and by the metrics,
+	//without them the clock is not read at all
+	if(!options.cascade && stage_metrics == nullptr)
+	{
+		plate_finders[strategy_index]->try_find_and_crop_plate_number(frame, candidates);
+	}
+	else
+	{
+		const auto started = std::chrono::steady_clock::now();
+		plate_finders[strategy_index]->try_find_and_crop_plate_number(frame, candidates);
+		const auto elapsed = std::chrono::steady_clock::now() - started;
+
+		if(options.cascade)
+			cascade->record_strategy_cost(strategy_index, elapsed);
+
+		if(stage_metrics != nullptr)
+			stage_metrics->record_strategy(strategy_index, elapsed, candidates.size() - first_candidate);
+	}
+
+	for(auto i = first_candidate; i < candidates.size(); i++)
+		candidates[i].strategy_index = strategy_index;
+}
+
+double plate_recognizer::initial_detection_scale() const
+{
+	if(options.expected_plate_height <= 0.0 || options.min_detection_plate_height <= 0.0)
+		return 1.0;
+
+	//never upscale, small plates are better served by the full resolution frame
+	return std::min(1.0, options.min_detection_plate_height / options.expected_plate_height);
+}
+
+int plate_recognizer::detection_reduction() const
+{
+	//the JPEG decoder can scale down by 2, 4 or 8 almost for free (it skips the high frequency coefficients)
+	//the biggest reduction that is still at or above the detection scale wins
+	const auto scale = initial_detection_scale();
+	for(auto reduction : { 8, 4, 2 })
+		if(1.0 / reduction >= scale)
+			return reduction;
+	return 1;
+}
+
+bool plate_recognizer::decode_into(frame_context& frame, const unsigned char* data, const size_t size) const
+{
+	if(data == nullptr || size == 0)
 		return false;
 
-	//remove whitespaces and irrelevant characters from detected plate number
-	//this will mitigate somewhat OCR detecting garbage in case of visual artifacts (after license plate detection)
-	const std::regex allowed_chars("[A-Za-z0-9]");
-	result.reserve(tmp.size());
+	const cv::Mat encoded(1, static_cast<int>(size), CV_8U, const_cast<unsigned char*>(data));
 
-	for(auto& c : tmp)
+	const auto reduction = detection_reduction();
+	if(reduction == 1)
 	{
-		auto current = std::string({ c });
-		if(std::regex_match(current, allowed_chars))
-			result.append(current);
+		cv::Mat image;
+		{
+			stage_timer timer(stage_metrics.get(), recognizer_stage::decode);
+			image = cv::imdecode(encoded, cv::IMREAD_COLOR);
+		}
+
+		if(!image.data)
+			return false;
+
+		frame.reset(image);
+		return true;
+	}
+
+	const auto reduced_flag =
+		reduction == 8 ? cv::IMREAD_REDUCED_GRAYSCALE_8 :
+		reduction == 4 ? cv::IMREAD_REDUCED_GRAYSCALE_4 :
+		cv::IMREAD_REDUCED_GRAYSCALE_2;
+
+	cv::Mat reduced_gray;
+	{
+		stage_timer timer(stage_metrics.get(), recognizer_stage::decode);
+		reduced_gray = cv::imdecode(encoded, reduced_flag);
+	}
+
+	if(!reduced_gray.data)
+		return false;
+
+	//the full resolution frame is decoded only if a strategy has something to crop (or detection escalates to a bigger scale)
+	frame.reset(reduced_gray, 1.0 / reduction, [encoded, metrics = stage_metrics.get()]
+	{
+		stage_timer timer(metrics, recognizer_stage::decode);
+		return cv::imdecode(encoded, cv::IMREAD_COLOR);
+	});
+	return true;
+}
+
+void plate_recognizer::find_plate_candidates(const std::vector<size_t>& strategy_indexes, frame_context& frame, std::vector<plate_candidate>& candidates) const
+{
+	//every strategy gets its own shard of candidates, so strategies running in parallel never contend on a shared result set
+	std::vector<std::vector<plate_candidate>> candidates_by_strategy(strategy_indexes.size());
+	const auto strategy_workers = options.parallel_strategies ? strategy_indexes.size() : 1;
+
+	//strategies record the time they spend cropping through the frame
+	frame.set_metrics(stage_metrics.get());
+	stage_timer timer(stage_metrics.get(), recognizer_stage::detect);
+
+	//a lazily decoded frame already has a reduced grayscale, start there instead of resizing the full frame
+	auto scale = frame.preferred_detection_scale() > 0.0 ? frame.preferred_detection_scale() : initial_detection_scale();
+	const auto first_candidate = candidates.size();
+	while(true)
+	{
+		frame.set_detection_scale(scale);
+
+		parallel_for(strategy_indexes.size(), strategy_workers, [&](const size_t i)
+		{
+			find_plate_candidates(strategy_indexes[i], frame, candidates_by_strategy[i]);
+		});
+
+		//concatenate shard by shard in the order of the strategies, so the results do not depend on which task finished first
+		for(auto& strategy_candidates : candidates_by_strategy)
+		{
+			for(auto& candidate : strategy_candidates)
+				candidates.push_back(std::move(candidate));
+			strategy_candidates.clear();
+		}
+
+		//the coarse pass found something (or we are already at full resolution), no need to look closer
+		if(candidates.size() > first_candidate || scale >= 1.0 || !options.escalate_detection_scale)
+			break;
+
+		scale = std::min(1.0, scale * 2.0);
 	}
+}
+
+void plate_recognizer::find_plate_candidates(frame_context& frame, std::vector<plate_candidate>& candidates) const
+{
+	std::vector<size_t> all_strategies(plate_finders.size());
+	std::iota(all_strategies.begin(), all_strategies.end(), 0);
+	find_plate_candidates(all_strategies, frame, candidates);
+
+	//a strategy often finds the same plate more than once, there is no point to OCR the same crop of it again
+	candidate_consolidation::suppress_overlapping(candidates, options.candidate_overlap_threshold);
+}
+
+bool plate_recognizer::is_confident_read(const ocr_read& read) const
+{
+	if(!read.succeeded || read.confidence < options.cascade_target_confidence)
+		return false;
+
+	const auto length = read.text.size();
+	return length >= options.expected_plate_length_min &&
+		(options.expected_plate_length_max == 0 || length <= options.expected_plate_length_max);
+}
+
+void plate_recognizer::read_plates_cascade(
+	frame_context& frame,
+	std::vector<plate_candidate>& candidates_read,
+	std::vector<ocr_read>& reads) const
+{
+	const auto strategy_order = cascade->strategies_by_cost();
+
+	size_t strategies_run = 0;
+	size_t candidates_skipped = 0;
+	size_t ocr_calls = 0;
+	auto early_exit = false;
+
+	for(auto strategy_index = strategy_order.begin(); strategy_index != strategy_order.end() && !early_exit; ++strategy_index)
+	{
+		std::vector<plate_candidate> candidates;
+		find_plate_candidates(std::vector<size_t> { *strategy_index }, frame, candidates);
+		strategies_run++;
+
+		//only duplicates within this strategy are dropped, a region an earlier strategy already read is OCR-ed again
+		//(it wasn't read confidently or the cascade would have stopped, and the crop of this strategy may read better)
+		candidate_consolidation::suppress_overlapping(candidates, options.candidate_overlap_threshold);
+
+		cascade_scheduler::order_by_prior(candidates, options.expected_plate_aspect_ratio);
+
+		//OCR in waves as big as the backend can take at once, so it is kept busy but we can still stop between the waves
+		const auto wave_size = std::max<size_t>(1, ocr->concurrency());
+		for(size_t first = 0; first < candidates.size(); first += wave_size)
+		{
+			const auto last = std::min(candidates.size(), first + wave_size);
+			std::vector<plate_candidate> wave(
+				std::make_move_iterator(candidates.begin() + first),
+				std::make_move_iterator(candidates.begin() + last));
+
+			std::vector<ocr_read> wave_reads;
+			execute_ocr(wave, wave_reads);
+			ocr_calls += wave.size();
+
+			const auto confident = std::any_of(wave_reads.begin(), wave_reads.end(), [this](const ocr_read& read) { return is_confident_read(read); });
+			for(size_t i = 0; i < wave.size(); i++)
+			{
+				candidates_read.push_back(std::move(wave[i]));
+				reads.push_back(std::move(wave_reads[i]));
+			}
+
+			if(confident)
+			{
+				early_exit = true;
+				candidates_skipped += candidates.size() - last;
+				break;
+			}
+		}
+	}
+
+	cascade->record_frame(early_exit, strategy_order.size() - strategies_run, candidates_skipped, ocr_calls);
+}
+
+void plate_recognizer::read_plates(frame_context& frame, std::vector<plate_candidate>& candidates, std::vector<ocr_read>& reads) const
+{
+	candidates.clear();
+	reads.clear();
+
+	//try to detect possible license plates, then forward them to tesseract for OCR-ing
+	//multiple license plate detection can be used to increase the chance of detecting something useful
+	if(options.cascade)
+	{
+		read_plates_cascade(frame, candidates, reads);
+		return;
+	}
+
+	find_plate_candidates(frame, candidates);
+
+	//for each detected plate try to apply OCR on them
+	execute_ocr(candidates, reads);
+}
+
+cascade_stats plate_recognizer::cascade_statistics() const
+{
+	return cascade->statistics();
+}
+
+void plate_recognizer::find_plate_candidates(const cv::Mat& image, std::vector<plate_candidate>& candidates) const
+{
+	if(stage_metrics != nullptr)
+		stage_metrics->record_frame();
+
+	auto& frame = thread_frame_context();
+	frame.reset(image);
+	find_plate_candidates(frame, candidates);
+}
+
+void plate_recognizer::find_plate_candidates(const raw_frame& image, std::vector<plate_candidate>& candidates) const
+{
+	if(stage_metrics != nullptr)
+		stage_metrics->record_frame();
+
+	auto& frame = thread_frame_context();
+	frame.reset(image);
+	find_plate_candidates(frame, candidates);
+}
+
+void plate_recognizer::find_plate_candidates(const cv::Mat& image, const std::vector<cv::Rect>& regions, std::vector<plate_candidate>& candidates) const
+{
+	find_plate_candidates_in_regions(cv::Size(image.cols, image.rows), regions, candidates,
+		[&image](frame_context& frame, const cv::Rect& region) { frame.reset(image(region)); });
+}
+
+void plate_recognizer::find_plate_candidates(const raw_frame& image, const std::vector<cv::Rect>& regions, std::vector<plate_candidate>& candidates) const
+{
+	image.throw_if_invalid();
+	find_plate_candidates_in_regions(cv::Size(image.width, image.height), regions, candidates,
+		[&image](frame_context& frame, const cv::Rect& region) { frame.reset(image.sub_frame(region)); });
+}
+
+void plate_recognizer::find_plate_candidates_in_regions(
+	const cv::Size& image_size,
+	const std::vector<cv::Rect>& regions,
+	std::vector<plate_candidate>& candidates,
+	const std::function<void(frame_context&, const cv::Rect&)>& reset_frame) const
+{
+	if(stage_metrics != nullptr)
+		stage_metrics->record_frame();
+
+	auto& frame = thread_frame_context();
+	const cv::Rect image_bounds(0, 0, image_size.width, image_size.height);
+	std::vector<plate_candidate> region_candidates;
+	for(const auto& region : regions)
+	{
+		const auto clipped = region & image_bounds;
+		if(clipped.area() == 0)
+			continue;
+
+		//the strategies see only the region (a header over the pixels of the image, nothing is copied)
+		region_candidates.clear();
+		reset_frame(frame, clipped);
+		find_plate_candidates(frame, region_candidates);
+
+		for(auto& candidate : region_candidates)
+		{
+			candidate.region += clipped.tl();
+			candidates.push_back(std::move(candidate));
+		}
+	}
+
+	//the regions may touch, so the same plate can be found in two of them
+	candidate_consolidation::suppress_overlapping(candidates, options.candidate_overlap_threshold);
+}
+
+void plate_recognizer::merge_reads(
+	const std::vector<ocr_read>& reads,
+	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
+	const int confidence_threshold)
+{
+	//a read is added unless its number is already there with at least the same confidence (so a more confident read of a number
+	//is added next to the earlier one) - the best confidence of each number is looked up in the multimap only once per call
+	std::unordered_map<std::string, int> best_confidence_by_number;
+	for(const auto& read : reads)
+	{
+		if(!read.succeeded || read.confidence < confidence_threshold)
+			continue;
+
+		auto best = best_confidence_by_number.find(read.text);
+		if(best == best_confidence_by_number.end())
+		{
+			//the map is ordered by confidence (highest first), the first entry of the number is its best one
+			auto confidence = std::numeric_limits<int>::min();
+			for(const auto& entry : parsed_numbers_by_confidence)
+			{
+				if(entry.second == read.text)
+				{
+					confidence = entry.first;
+					break;
+				}
+			}
+			best = best_confidence_by_number.emplace(read.text, confidence).first;
+		}
+
+		if(best->second >= read.confidence)
+			continue;
 
-	return result.size() > 3;
+		parsed_numbers_by_confidence.emplace(read.confidence, read.text);
+		best->second = read.confidence;
+	}
 }
 
 bool plate_recognizer::try_parse(
 	const std::string& image_path,
 	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
-	int confidence_threshold)
+	const int confidence_threshold)
+{
+	//mapped and not read, the decoder pulls in only the pages it touches
+	const mapped_file file(image_path);
+	if(!file.is_open())
+		throw_if_invalid(cv::Mat());
+
+	return try_parse_encoded(file.data(), file.size(), parsed_numbers_by_confidence, confidence_threshold);
+}
+
+bool plate_recognizer::try_parse_encoded(
+	const unsigned char* data,
+	const size_t size,
+	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
+	const int confidence_threshold)
 {
-	return try_parse(cv::imread(image_path), parsed_numbers_by_confidence);
+	auto& frame = thread_frame_context();
+	if(!decode_into(frame, data, size))
+		throw_if_invalid(cv::Mat());
+
+	const auto found_anything = try_parse(frame, parsed_numbers_by_confidence, confidence_threshold);
+
+	//the lazy decoder points to the caller's buffer, it must not outlive this call
+	frame.reset(cv::Mat());
+	return found_anything;
 }
 
 bool plate_recognizer::try_parse(
-	const cv::Mat& image, 
+	const cv::Mat& image,
 	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
-	int confidence_threshold)
+	const int confidence_threshold)
 {
 	throw_if_invalid(image);
 
-	const auto value_exists = 
-		[](const int confidence, 
-		   const std::string& val, 
-		   std::multimap<int, std::string, std::greater<int>>& dict)
-		{
-			for(const auto& entry : dict)
-				if(entry.second == val && entry.first >= confidence)
-					return true;
-			return false;
-		};
-	
-	for(auto& strategy : plate_finders)
-	{
-		std::vector<cv::Mat> plate_candidates;
-
-#ifdef PRINTF_DEBUG
-		int strategy_index = 0;
-#endif
-		//try to detect possible license plates, then forward them to tesseract for OCR-ing
-		//multiple license plate detection can be used to increase the chance of detecting something useful
-		//in the end, the results will be sorted by OCR confidence score (0-100 where 100 means the highest confidence)
-		if(strategy->try_find_and_crop_plate_number(image, plate_candidates))			
+	//all of the strategies share the same frame, so things like grayscale conversion are done only once
+	auto& frame = thread_frame_context();
+	frame.reset(image);
+
+	return try_parse(frame, parsed_numbers_by_confidence, confidence_threshold);
+}
+
+bool plate_recognizer::try_parse(
+	const raw_frame& image,
+	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
+	const int confidence_threshold)
+{
+	//the frame is only wrapped, detection reads the caller's memory directly
+	auto& frame = thread_frame_context();
+	frame.reset(image);
+
+	return try_parse(frame, parsed_numbers_by_confidence, confidence_threshold);
+}
+
+bool plate_recognizer::try_parse(
+	const std::string& image_path,
+	recognition_result& result,
+	const int confidence_threshold)
+{
+	//mapped and not read, the decoder pulls in only the pages it touches
+	const mapped_file file(image_path);
+	if(!file.is_open())
+		throw_if_invalid(cv::Mat());
+
+	return try_parse_encoded(file.data(), file.size(), result, confidence_threshold);
+}
+
+bool plate_recognizer::try_parse_encoded(
+	const unsigned char* data,
+	const size_t size,
+	recognition_result& result,
+	const int confidence_threshold)
+{
+	auto& frame = thread_frame_context();
+	if(!decode_into(frame, data, size))
+		throw_if_invalid(cv::Mat());
+
+	const auto found_anything = try_parse(frame, result, confidence_threshold);
+
+	//the lazy decoder points to the caller's buffer, it must not outlive this call
+	frame.reset(cv::Mat());
+	return found_anything;
+}
+
+bool plate_recognizer::try_parse(
+	const cv::Mat& image,
+	recognition_result& result,
+	const int confidence_threshold)
+{
+	throw_if_invalid(image);
+
+	//all of the strategies share the same frame, so things like grayscale conversion are done only once
+	auto& frame = thread_frame_context();
+	frame.reset(image);
+
+	return try_parse(frame, result, confidence_threshold);
+}
+
+bool plate_recognizer::try_parse(
+	const raw_frame& image,
+	recognition_result& result,
+	const int confidence_threshold)
+{
+	//the frame is only wrapped, detection reads the caller's memory directly
+	auto& frame = thread_frame_context();
+	frame.reset(image);
+
+	return try_parse(frame, result, confidence_threshold);
+}
+
+bool plate_recognizer::try_parse(
+	frame_context& frame,
+	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
+	const int confidence_threshold)
+{
+	stage_timer timer(stage_metrics.get(), recognizer_stage::total);
+	if(stage_metrics != nullptr)
+		stage_metrics->record_frame();
+
+	std::vector<plate_candidate> plate_candidates;
+	std::vector<ocr_read> reads;
+	read_plates(frame, plate_candidates, reads);
+
+	//merge in the order of the candidates, so the results do not depend on which OCR finished first
+	{
+		stage_timer merge_timer(stage_metrics.get(), recognizer_stage::merge);
+		merge_reads(reads, parsed_numbers_by_confidence, confidence_threshold);
+	}
+
+	return !parsed_numbers_by_confidence.empty();
+}
+
+bool plate_recognizer::try_parse(
+	frame_context& frame,
+	recognition_result& result,
+	const int confidence_threshold)
+{
+	result.clear();
+
+	stage_timer timer(stage_metrics.get(), recognizer_stage::total);
+	if(stage_metrics != nullptr)
+		stage_metrics->record_frame();
+
+	std::vector<plate_candidate> plate_candidates;
+	std::vector<ocr_read> reads;
+	read_plates(frame, plate_candidates, reads);
+
+	//merge in the order of the candidates, so the results do not depend on which OCR finished first
+	//in the end, the results are sorted by OCR confidence score (0-100 where 100 means the highest confidence)
+	{
+		stage_timer merge_timer(stage_metrics.get(), recognizer_stage::merge);
+		result.add(plate_candidates, reads, confidence_threshold);
+		result.sort_by_confidence();
+	}
+
+	return !result.empty();
+}
+
+bool plate_recognizer::try_parse_batch(
+	const std::vector<std::string>& image_paths,
+	std::vector<std::multimap<int, std::string, std::greater<int>>>& parsed_numbers_by_image,
+	batch_stats& stats,
+	const int confidence_threshold)
+{
+	return run_batch_pipeline(
+		image_paths.size(),
+		[&](const size_t i) { return cv::imread(image_paths[i]); },
+		parsed_numbers_by_image,
+		stats,
+		confidence_threshold);
+}
+
+bool plate_recognizer::try_parse_batch(
+	const std::vector<cv::Mat>& images,
+	std::vector<std::multimap<int, std::string, std::greater<int>>>& parsed_numbers_by_image,
+	batch_stats& stats,
+	const int confidence_threshold)
+{
+	//already decoded, so the first stage only hands the images over (cv::Mat copies share the pixels)
+	return run_batch_pipeline(
+		images.size(),
+		[&](const size_t i) { return images[i]; },
+		parsed_numbers_by_image,
+		stats,
+		confidence_threshold);
+}
+
+bool plate_recognizer::run_batch_pipeline(
+	const size_t image_count,
+	const std::function<cv::Mat(size_t)>& load_image,
+	std::vector<std::multimap<int, std::string, std::greater<int>>>& parsed_numbers_by_image,
+	batch_stats& stats,
+	const int confidence_threshold)
+{
+	using clock = std::chrono::steady_clock;
+
+	struct decoded_image
+	{
+		size_t image_index = 0;
+		cv::Mat image;
+	};
+
+	struct plate_candidate_item
+	{
+		size_t image_index = 0;
+		size_t read_index = 0;
+		plate_candidate candidate;
+	};
+
+	const auto started_at = clock::now();
+
+	stats = batch_stats();
+	stats.decode.workers = std::max<size_t>(1, options.batch_decode_workers);
+	stats.detect.workers = std::max<size_t>(1, options.batch_detect_workers);
+	stats.ocr.workers = options.batch_ocr_workers > 0 ? options.batch_ocr_workers : ocr->concurrency();
+
+	bounded_queue<decoded_image> decoded_images(options.batch_queue_capacity);
+	bounded_queue<plate_candidate_item> plate_candidates(options.batch_queue_capacity);
+
+	//detection sizes the reads of an image before handing its candidates over to OCR,
+	//so OCR workers can write into their slots without any locking
+	std::vector<std::vector<ocr_read>> reads_by_image(image_count);
+
+	std::atomic<size_t> next_image(0);
+	std::atomic<size_t> failed_images(0);
+
+	std::mutex stats_sync;
+	const auto add_stage_stats = [&](pipeline_stage_stats& total, const pipeline_stage_stats& worker_stats)
+	{
+		std::lock_guard<std::mutex> lock(stats_sync);
+		total += worker_stats;
+	};
+
+	//if any stage fails, unblock everybody else so the pipeline can wind down
+	const auto abort_pipeline = [&]
+	{
+		decoded_images.close();
+		plate_candidates.close();
+	};
+
+	const auto decode_worker = [&]
+	{
+		pipeline_stage_stats worker_stats;
+		for(auto i = next_image++; i < image_count; i = next_image++)
 		{
-#ifdef PRINTF_DEBUG
-			int candidate_index = 0;
-#endif
-			//for each detected plate try to apply OCR on them
-			for(auto& plate_image : plate_candidates)
-			{
-				std::string plate_number_as_text;
-				int confidence;
-
-#ifdef PRINTF_DEBUG
-				std::ostringstream filename_stream;
-			    filename_stream << "plate_candidate_" << strategy_index << "_" << candidate_index++ << ".png";
-				cv::imwrite(filename_stream.str(), plate_image);
-#endif
-				if(try_execute_ocr(plate_image, plate_number_as_text, confidence) && confidence >= confidence_threshold)
-				{
-					if(!value_exists(confidence, plate_number_as_text, parsed_numbers_by_confidence))
-						parsed_numbers_by_confidence.insert(std::make_pair(confidence, plate_number_as_text));
-				}
+			const auto begin = clock::now();
+			auto image = load_image(i);
+			const auto elapsed = clock::now() - begin;
+			worker_stats.busy_time += elapsed;
+			if(stage_metrics != nullptr)
+				stage_metrics->record_stage(recognizer_stage::decode, elapsed);
+			worker_stats.processed_items++;
 
-				plate_number_as_text = "";
-				confidence = 0;
+			if(!image.data)
+			{
+				failed_images++;
+				continue;
 			}
-#ifdef PRINTF_DEBUG
-			strategy_index++;
-#endif
+
+			if(!decoded_images.push({ i, std::move(image) }))
+				break;
+		}
+		add_stage_stats(stats.decode, worker_stats);
+	};
+
+	const auto detect_worker = [&]
+	{
+		pipeline_stage_stats worker_stats;
+		decoded_image item;
+		frame_context frame;
+		while(decoded_images.pop(item))
+		{
+			const auto begin = clock::now();
+			frame.reset(item.image);
+			if(stage_metrics != nullptr)
+				stage_metrics->record_frame();
+
+			//the order of the candidates is the same as in try_parse(), strategy after strategy
+			std::vector<plate_candidate> candidates;
+			find_plate_candidates(frame, candidates);
+
+			reads_by_image[item.image_index].resize(candidates.size());
+
+			worker_stats.busy_time += clock::now() - begin;
+			worker_stats.processed_items++;
+
+			for(size_t i = 0; i < candidates.size(); i++)
+				plate_candidates.push({ item.image_index, i, std::move(candidates[i]) });
+		}
+		add_stage_stats(stats.detect, worker_stats);
+	};
+
+	const auto ocr_worker = [&]
+	{
+		pipeline_stage_stats worker_stats;
+		plate_candidate_item item;
+		while(plate_candidates.pop(item))
+		{
+			const auto begin = clock::now();
+			ocr_candidate(item.candidate, reads_by_image[item.image_index][item.read_index]);
+			worker_stats.busy_time += clock::now() - begin;
+			worker_stats.processed_items++;
 		}
+		add_stage_stats(stats.ocr, worker_stats);
+	};
+
+	//each stage closes its output queue once all of its workers are done, this is how the next stage knows there is no more work
+	const auto run_stage = [&](const size_t workers, const std::function<void()>& worker, const std::function<void()>& on_done)
+	{
+		try
+		{
+			parallel_for(workers, workers, [&](size_t) { worker(); });
+		}
+		catch(...)
+		{
+			abort_pipeline();
+			throw;
+		}
+		on_done();
+	};
+
+	auto decode_stage = std::async(std::launch::async, [&]
+	{
+		run_stage(stats.decode.workers, decode_worker, [&] { decoded_images.close(); });
+	});
+
+	auto detect_stage = std::async(std::launch::async, [&]
+	{
+		run_stage(stats.detect.workers, detect_worker, [&] { plate_candidates.close(); });
+	});
+
+	std::exception_ptr error;
+	try
+	{
+		run_stage(stats.ocr.workers, ocr_worker, [] { });
+	}
+	catch(...)
+	{
+		error = std::current_exception();
 	}
 
-	return !parsed_numbers_by_confidence.empty();
+	for(auto* stage : { &decode_stage, &detect_stage })
+	{
+		try
+		{
+			stage->get();
+		}
+		catch(...)
+		{
+			if(!error)
+				error = std::current_exception();
+		}
+	}
+
+	if(error)
+		std::rethrow_exception(error);
+
+	parsed_numbers_by_image.clear();
+	parsed_numbers_by_image.resize(image_count);
+
+	auto found_anything = false;
+	for(size_t i = 0; i < image_count; i++)
+	{
+		merge_reads(reads_by_image[i], parsed_numbers_by_image[i], confidence_threshold);
+		found_anything |= !parsed_numbers_by_image[i].empty();
+	}
+
+	stats.failed_images = failed_images;
+	stats.wall_time = clock::now() - started_at;
+
+	return found_anything;
 }
 
 plate_recognizer::plate_recognizer(): plate_recognizer(std::vector<std::shared_ptr<base_plate_finder_strategy>>())
@@ -109,8 +773,11 @@ plate_recognizer& plate_recognizer::operator=(const plate_recognizer& other)
 {
 	if (this == &other)
 		return *this;
-	ocr_api = other.ocr_api;
+	ocr = other.ocr;
 	plate_finders = other.plate_finders;
+	options = other.options;
+	cascade = other.cascade;
+	stage_metrics = other.stage_metrics;
 	return *this;
 }
 
@@ -118,33 +785,33 @@ plate_recognizer& plate_recognizer::operator=(plate_recognizer&& other) noexcept
 {
 	if (this == &other)
 		return *this;
-	ocr_api = other.ocr_api;
+	ocr = std::move(other.ocr);
 	plate_finders = std::move(other.plate_finders);
+	options = other.options;
+	cascade = std::move(other.cascade);
+	stage_metrics = std::move(other.stage_metrics);
 	return *this;
 }
 
-plate_recognizer::~plate_recognizer()
+plate_recognizer::~plate_recognizer() = default;
+
+plate_recognizer::plate_recognizer(
+	const std::vector<std::shared_ptr<base_plate_finder_strategy>>& plate_finder_strategies,
+	const recognizer_options& options)
+	: plate_recognizer(plate_finder_strategies, std::make_shared<tesseract_ocr_backend>(options.ocr_pool_size), options)
 {
-	ocr_api.End();
 }
 
-plate_recognizer::plate_recognizer(const std::vector<std::shared_ptr<base_plate_finder_strategy>>& plate_finder_strategies)
-	: plate_finders(plate_finder_strategies)
+plate_recognizer::plate_recognizer(
+	const std::vector<std::shared_ptr<base_plate_finder_strategy>>& plate_finder_strategies,
+	std::shared_ptr<ocr_backend> ocr,
+	const recognizer_options& options)
+	: ocr(std::move(ocr)),
+	  plate_finders(plate_finder_strategies),
+	  options(options),
+	  cascade(std::make_shared<cascade_scheduler>(plate_finder_strategies.size())),
+	  stage_metrics(options.enable_metrics ? std::make_shared<recognizer_metrics>(plate_finder_strategies.size()) : nullptr)
 {
-	//note: tesseract requires data directory for it to work properly where the executable works
-	//by default, the directory is 'tessdata' and it should contain files like 'eng.traineddata' per each language that is used with it.
-	//without the directory and some training files, tesseract api will fail to initialize
-
-	ocr_api.SetVariable("load_system_dawg", "0");
-	ocr_api.SetVariable("load_freq_dawg", "0");
-	ocr_api.SetVariable("load_punc_dawg", "0");
-	ocr_api.SetVariable("load_number_dawg", "0");
-	ocr_api.SetVariable("load_unambig_dawg", "0");
-	ocr_api.SetVariable("load_bigram_dawg", "0");
-	ocr_api.SetVariable("load_fixed_length_dawgs", "0");
-
-	if (ocr_api.Init(nullptr, "eng", tesseract::OEM_TESSERACT_LSTM_COMBINED) == -1)
-		throw std::exception("Failed to initialize tesseract");
-
-	ocr_api.SetPageSegMode(tesseract::PageSegMode::PSM_SINGLE_WORD);
+	if(this->ocr == nullptr)
+		throw std::invalid_argument("plate_recognizer needs an OCR backend");
 }
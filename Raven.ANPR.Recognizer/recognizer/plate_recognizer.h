@@ -7,23 +7,159 @@
 #include <map>
 #include <tesseract/baseapi.h>
 #include "base_plate_finder_strategy.hpp"
+#include "plate_candidate.hpp"
+#include "frame_context.hpp"
+#include "raw_frame.hpp"
+#include "ocr_engine_pool.h"
+#include "ocr_backend.hpp"
+#include "recognizer_options.hpp"
+#include "batch_stats.hpp"
+#include "cascade_scheduler.hpp"
+#include "recognizer_metrics.hpp"
+#include "recognition_result.hpp"
 #include <atomic>
+#include <functional>
 
 class plate_recognizer
 {
+public:
+	//outcome of OCR on a single plate candidate (see ocr_backend.hpp)
+	using ocr_read = ::ocr_read;
+
 private:
-	tesseract::TessBaseAPI ocr_api;
+	std::shared_ptr<ocr_backend> ocr;
 	std::vector<std::shared_ptr<base_plate_finder_strategy>> plate_finders;
-	bool try_execute_ocr(cv::Mat& plate_image, std::string& result, int& confidence);
+	recognizer_options options;
+	std::shared_ptr<cascade_scheduler> cascade;
+
+	//null unless recognizer_options::enable_metrics is on
+	std::shared_ptr<recognizer_metrics> stage_metrics;
+
+	//frame context of the calling thread, its buffers are reused by all of the frames that thread processes
+	static frame_context& thread_frame_context();
+
+	//run a single strategy, its candidates are appended to 'candidates'
+	void find_plate_candidates(size_t strategy_index, frame_context& frame, std::vector<plate_candidate>& candidates) const;
+
+	//scale of the first detection pass, derived from the expected plate height in the options
+	double initial_detection_scale() const;
+
+	//run the given strategies (in parallel, if enabled) on the downscaled frame, escalate the scale while nothing was found
+	void find_plate_candidates(const std::vector<size_t>& strategy_indexes, frame_context& frame, std::vector<plate_candidate>& candidates) const;
+
+	//run all of the strategies, then collapse candidates that cover the same region
+	void find_plate_candidates(frame_context& frame, std::vector<plate_candidate>& candidates) const;
+
+	//run detection on each of the regions separately, 'reset_frame' points the frame at a region of the image
+	void find_plate_candidates_in_regions(
+		const cv::Size& image_size,
+		const std::vector<cv::Rect>& regions,
+		std::vector<plate_candidate>& candidates,
+		const std::function<void(frame_context&, const cv::Rect&)>& reset_frame) const;
+
+	//detection and OCR of a frame that is already set up, the reads are in the same order as the candidates
+	//(both forms of try_parse() merge them, each in its own way)
+	void read_plates(frame_context& frame, std::vector<plate_candidate>& candidates, std::vector<ocr_read>& reads) const;
+
+	//cascade mode of read_plates(), see recognizer_options::cascade - only the candidates it got to are returned
+	void read_plates_cascade(frame_context& frame, std::vector<plate_candidate>& candidates, std::vector<ocr_read>& reads) const;
+
+	//how much the JPEG decoder should scale the detection grayscale down (1, 2, 4 or 8), derived from initial_detection_scale()
+	int detection_reduction() const;
+
+	//decode an encoded image into the frame - a reduced grayscale for detection and a lazy full resolution decode
+	//(or a plain full decode, if detection runs at full resolution anyway), false if the image can't be decoded
+	bool decode_into(frame_context& frame, const unsigned char* data, size_t size) const;
+
+	//detection, OCR and merge of a frame that is already set up
+	bool try_parse(frame_context& frame, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold);
+	bool try_parse(frame_context& frame, recognition_result& result, int confidence_threshold);
+
+	//OCR a single candidate with the OCR backend
+	void ocr_candidate(plate_candidate& candidate, ocr_read& read) const;
+
+	//a read good enough to stop the cascade
+	bool is_confident_read(const ocr_read& read) const;
+
+	//decode -> detect -> OCR pipeline behind both try_parse_batch() overloads, 'load_image' is the decode stage
+	bool run_batch_pipeline(
+		size_t image_count,
+		const std::function<cv::Mat(size_t)>& load_image,
+		std::vector<std::multimap<int, std::string, std::greater<int>>>& parsed_numbers_by_image,
+		batch_stats& stats,
+		int confidence_threshold);
 
 	static void throw_if_invalid(const cv::Mat& image);
 public:
 
+	//the file is memory mapped and decoded as described in try_parse_encoded()
 	bool try_parse(const std::string& image_path, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold = 35);
+
+	//recognize plates in an encoded image (JPEG, PNG, ...) in memory
+	//when detection runs on a downscaled frame (see recognizer_options::expected_plate_height) the image is decoded straight into
+	//a reduced grayscale, and the full resolution pixels are decoded only for frames where a strategy has something to crop
+	bool try_parse_encoded(const unsigned char* data, size_t size, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold = 35);
 	bool try_parse(const cv::Mat& image, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold = 35);
 
+	//recognize plates in a frame owned by the caller (like a capture card buffer in NV12) without copying or converting it
+	//detection reads the grayscale (or the Y plane) in place and only the cropped candidates get their own memory
+	bool try_parse(const raw_frame& image, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold = 35);
+
+	//same as the overloads above, but the plates go into a recognition_result - with the region and the strategy of each of them,
+	//and without allocating anything once the result is reused from call to call
+	//the result is cleared first, the entries are sorted by confidence (highest first), false if nothing was read
+	//unlike the multimap, a result has room for a limited number of plates, and only for texts short enough to be a plate number
+	//(see recognition_result::overflowed())
+	bool try_parse(const std::string& image_path, recognition_result& result, int confidence_threshold = 35);
+	bool try_parse_encoded(const unsigned char* data, size_t size, recognition_result& result, int confidence_threshold = 35);
+	bool try_parse(const cv::Mat& image, recognition_result& result, int confidence_threshold = 35);
+	bool try_parse(const raw_frame& image, recognition_result& result, int confidence_threshold = 35);
+
+	//recognize many images in one go - decoding, plate detection and OCR run as separate pipeline stages with bounded queues between them,
+	//so decoding of one image overlaps with detection and OCR of the others
+	//there is one result set per input image (in the same order as the input), images that fail to load get an empty result set
+	bool try_parse_batch(const std::vector<std::string>& image_paths, std::vector<std::multimap<int, std::string, std::greater<int>>>& parsed_numbers_by_image, batch_stats& stats, int confidence_threshold = 35);
+	bool try_parse_batch(const std::vector<cv::Mat>& images, std::vector<std::multimap<int, std::string, std::greater<int>>>& parsed_numbers_by_image, batch_stats& stats, int confidence_threshold = 35);
+
+	//the building blocks of try_parse(), for callers that want to decide what gets OCR-ed (like plate_stream_recognizer)
+
+	//detection only: run all of the strategies on the image, the candidates are ordered strategy after strategy
+	//candidates that overlap a bigger one of the same strategy too much are dropped (see recognizer_options::candidate_overlap_threshold)
+	void find_plate_candidates(const cv::Mat& image, std::vector<plate_candidate>& candidates) const;
+	void find_plate_candidates(const raw_frame& image, std::vector<plate_candidate>& candidates) const;
+
+	//detection only on parts of the image (like the changed regions reported by a motion_gate), the rest of the image is not looked at
+	//the regions of the candidates are in the coordinates of the whole image
+	void find_plate_candidates(const cv::Mat& image, const std::vector<cv::Rect>& regions, std::vector<plate_candidate>& candidates) const;
+	void find_plate_candidates(const raw_frame& image, const std::vector<cv::Rect>& regions, std::vector<plate_candidate>& candidates) const;
+
+	//OCR a single plate image (see candidate_normalization) with the given engine, only alphanumeric characters are kept in 'result'
+	//(see tesseract_ocr_backend::try_execute_ocr())
+	static bool try_execute_ocr(tesseract::TessBaseAPI& ocr_api, const cv::Mat& plate_image, std::string& result, int& confidence);
+
+	//OCR all of the candidates concurrently, as many at a time as the OCR backend can take
+	//the reads are returned in the same order as the candidates
+	void execute_ocr(std::vector<plate_candidate>& plate_candidates, std::vector<ocr_read>& reads) const;
+
+	//add the reads that pass the threshold to the results, skipping numbers that were already read with higher confidence
+	static void merge_reads(const std::vector<ocr_read>& reads, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold);
+
+	//how often the cascade mode managed to exit early (all of the try_parse() calls so far)
+	cascade_stats cascade_statistics() const;
+
+	//latency, candidate and OCR counters of all of the calls so far, null if recognizer_options::enable_metrics is off
+	const recognizer_metrics* metrics() const { return stage_metrics.get(); }
+	void reset_metrics() { if(stage_metrics != nullptr) stage_metrics->reset(); }
+
 	explicit plate_recognizer();
-	explicit plate_recognizer(const std::vector<std::shared_ptr<base_plate_finder_strategy>>& plate_finder_strategies);
+	explicit plate_recognizer(const std::vector<std::shared_ptr<base_plate_finder_strategy>>& plate_finder_strategies, const recognizer_options& options = recognizer_options());
+
+	//same, with a custom OCR backend instead of the default tesseract one (which uses recognizer_options::ocr_pool_size engines)
+	//for example char_classifier_backend, that reads the plates character by character and falls back to tesseract when unsure
+	plate_recognizer(
+		const std::vector<std::shared_ptr<base_plate_finder_strategy>>& plate_finder_strategies,
+		std::shared_ptr<ocr_backend> ocr,
+		const recognizer_options& options = recognizer_options());
 
 	plate_recognizer& operator=(const plate_recognizer& other);
 	plate_recognizer& operator=(plate_recognizer&& other) noexcept;
@@ -0,0 +1,240 @@
+#include "plate_stream_recognizer.h"
+#include "candidate_consolidation.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <tuple>
+
+plate_stream_recognizer::plate_stream_recognizer(std::shared_ptr<plate_recognizer> recognizer, const stream_options& options)
+	: recognizer(std::move(recognizer)),
+	  options(options),
+	  gate(options.motion)
+{
+	if(this->recognizer == nullptr)
+		throw std::invalid_argument("plate_stream_recognizer needs a plate_recognizer to work with");
+}
+
+std::vector<int> plate_stream_recognizer::match_candidates_to_tracks(const std::vector<plate_candidate>& candidates) const
+{
+	//(overlap, candidate index, track index) of every pair that overlaps enough
+	std::vector<std::tuple<double, size_t, size_t>> pairs;
+	for(size_t c = 0; c < candidates.size(); c++)
+	{
+		for(size_t t = 0; t < tracks.size(); t++)
+		{
+			//different strategies crop the same plate differently, so their reads are not interchangeable
+			if(tracks[t].strategy_index != candidates[c].strategy_index)
+				continue;
+
+			const auto iou = candidate_consolidation::intersection_over_union(candidates[c].region, tracks[t].region);
+			if(iou >= options.min_iou)
+				pairs.emplace_back(iou, c, t);
+		}
+	}
+
+	//greedy assignment, the best overlapping pairs get matched first
+	std::stable_sort(pairs.begin(), pairs.end(),
+		[](const std::tuple<double, size_t, size_t>& a, const std::tuple<double, size_t, size_t>& b) { return std::get<0>(a) > std::get<0>(b); });
+
+	std::vector<int> track_by_candidate(candidates.size(), -1);
+	std::vector<bool> track_taken(tracks.size(), false);
+	for(const auto& pair : pairs)
+	{
+		const auto candidate_index = std::get<1>(pair);
+		const auto track_index = std::get<2>(pair);
+		if(track_by_candidate[candidate_index] != -1 || track_taken[track_index])
+			continue;
+
+		track_by_candidate[candidate_index] = static_cast<int>(track_index);
+		track_taken[track_index] = true;
+	}
+
+	return track_by_candidate;
+}
+
+bool plate_stream_recognizer::needs_ocr(const plate_track& track) const
+{
+	if(track.has_read && track.confidence >= options.stable_confidence)
+		return options.refresh_interval > 0 && track.frames_since_ocr >= options.refresh_interval;
+
+	if(track.failed_reads == 0 || options.max_retry_interval == 0)
+		return true;
+
+	//a plate that couldn't be read in this frame most likely can't be read in the next one either,
+	//so an unreadable plate parked in view shouldn't cost an OCR on every frame
+	if(options.retry_growth > 0 && track.region.area() >= track.ocr_region.area() * options.retry_growth)
+		return true;
+
+	const auto backoff = std::min<size_t>(options.max_retry_interval, size_t(1) << std::min<size_t>(track.failed_reads, 16));
+	return track.frames_since_ocr + 1 >= backoff;
+}
+
+template<class frame_type>
+bool plate_stream_recognizer::find_candidates(const frame_type& frame, std::vector<plate_candidate>& candidates)
+{
+	if(!options.motion_gating)
+	{
+		recognizer->find_plate_candidates(frame, candidates);
+		return true;
+	}
+
+	if(!gate.update(frame, changed_regions))
+		return false;
+
+	recognizer->find_plate_candidates(frame, changed_regions, candidates);
+	return true;
+}
+
+bool plate_stream_recognizer::was_searched(const cv::Rect& region) const
+{
+	if(!options.motion_gating)
+		return true;
+
+	//with motion gating only the changed parts of the frame were searched, a plate outside of them wasn't missed,
+	//nothing moved there (a parked car stays tracked while the traffic passes next to it)
+	for(const auto& changed_region : changed_regions)
+		if((changed_region & region).area() > 0)
+			return true;
+
+	return false;
+}
+
+bool plate_stream_recognizer::skip_frame()
+{
+	//nothing moved, so the tracks are left as they are - they don't age, a parked car is still there when the traffic picks up again
+	stats.frames++;
+	stats.gated_frames++;
+	return false;
+}
+
+bool plate_stream_recognizer::try_parse_frame(
+	const cv::Mat& frame,
+	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
+	const int confidence_threshold)
+{
+	if (!frame.data)
+		throw std::runtime_error("Failed to load the plate image (Is the image corrupted?)");
+
+	std::vector<plate_candidate> candidates;
+	if(!find_candidates(frame, candidates))
+		return skip_frame();
+
+	return track_and_read(candidates, parsed_numbers_by_confidence, confidence_threshold);
+}
+
+bool plate_stream_recognizer::try_parse_frame(
+	const raw_frame& frame,
+	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
+	const int confidence_threshold)
+{
+	std::vector<plate_candidate> candidates;
+	if(!find_candidates(frame, candidates))
+		return skip_frame();
+
+	return track_and_read(candidates, parsed_numbers_by_confidence, confidence_threshold);
+}
+
+bool plate_stream_recognizer::track_and_read(
+	std::vector<plate_candidate>& candidates,
+	std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence,
+	const int confidence_threshold)
+{
+	stats.frames++;
+	stats.candidates += candidates.size();
+
+	auto track_by_candidate = match_candidates_to_tracks(candidates);
+	std::vector<bool> seen_in_frame(tracks.size(), false);
+
+	//candidates that need OCR, and the tracks their reads belong to
+	std::vector<plate_candidate> to_read;
+	std::vector<size_t> to_read_tracks;
+
+	for(size_t c = 0; c < candidates.size(); c++)
+	{
+		if(track_by_candidate[c] == -1)
+		{
+			plate_track track;
+			track.id = next_track_id++;
+			track.strategy_index = candidates[c].strategy_index;
+			tracks.push_back(track);
+			seen_in_frame.push_back(false);
+			track_by_candidate[c] = static_cast<int>(tracks.size() - 1);
+			stats.tracks_created++;
+		}
+
+		const auto track_index = static_cast<size_t>(track_by_candidate[c]);
+		auto& track = tracks[track_index];
+		track.region = candidates[c].region;
+		track.frames_seen++;
+		track.missed_frames = 0;
+		seen_in_frame[track_index] = true;
+
+		if(needs_ocr(track))
+		{
+			track.ocr_region = track.region;
+			to_read.push_back(candidates[c]);
+			to_read_tracks.push_back(track_index);
+		}
+		else
+		{
+			track.frames_since_ocr++;
+			if(track.has_read && track.confidence >= options.stable_confidence)
+				stats.reused_reads++;
+			else
+				stats.deferred_reads++;
+		}
+	}
+
+	std::vector<plate_recognizer::ocr_read> new_reads;
+	recognizer->execute_ocr(to_read, new_reads);
+	stats.ocr_calls += to_read.size();
+
+	for(size_t i = 0; i < new_reads.size(); i++)
+	{
+		auto& track = tracks[to_read_tracks[i]];
+		const auto& read = new_reads[i];
+		track.frames_since_ocr = 0;
+
+		//keep the best read of the track, a blurry frame shouldn't override a good read
+		if(read.succeeded && (!track.has_read || read.confidence > track.confidence))
+		{
+			track.plate_number = read.text;
+			track.confidence = read.confidence;
+			track.has_read = true;
+		}
+
+		if(track.has_read && track.confidence >= options.stable_confidence)
+			track.failed_reads = 0;
+		else
+			track.failed_reads++;
+	}
+
+	//report the reads of the tracks seen in this frame, in the order of the candidates (just like try_parse() does)
+	std::vector<plate_recognizer::ocr_read> frame_reads(candidates.size());
+	for(size_t c = 0; c < candidates.size(); c++)
+	{
+		const auto& track = tracks[static_cast<size_t>(track_by_candidate[c])];
+		frame_reads[c].text = track.plate_number;
+		frame_reads[c].confidence = track.confidence;
+		frame_reads[c].succeeded = track.has_read;
+	}
+	plate_recognizer::merge_reads(frame_reads, parsed_numbers_by_confidence, confidence_threshold);
+
+	//age the tracks that were not seen and drop those that are gone for too long
+	for(size_t t = 0; t < tracks.size(); t++)
+		if(!seen_in_frame[t] && was_searched(tracks[t].region))
+			tracks[t].missed_frames++;
+
+	tracks.erase(
+		std::remove_if(tracks.begin(), tracks.end(),
+			[this](const plate_track& track) { return track.missed_frames > options.max_missed_frames; }),
+		tracks.end());
+
+	return !parsed_numbers_by_confidence.empty();
+}
+
+void plate_stream_recognizer::reset()
+{
+	tracks.clear();
+	stats = stream_stats();
+	gate.reset();
+}
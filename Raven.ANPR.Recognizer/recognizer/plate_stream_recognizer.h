@@ -0,0 +1,128 @@
+#ifndef PLATE_STREAM_RECOGNIZER_H
+#define PLATE_STREAM_RECOGNIZER_H
+
+#include "plate_recognizer.h"
+#include "motion_gate.hpp"
+#include <memory>
+
+//tuning knobs of plate_stream_recognizer
+struct stream_options
+{
+	//minimal intersection-over-union between a candidate and a track (from the previous frames) to treat them as the same plate
+	double min_iou = 0.3;
+
+	//a track with a read of at least this confidence is considered stable and its read is reused instead of re-running OCR
+	int stable_confidence = 75;
+
+	//even stable tracks are re-OCR-ed once in this many frames, zero means never
+	size_t refresh_interval = 0;
+
+	//a track whose OCR failed (or wasn't confident enough) is retried with an exponential backoff - in 2, 4, 8, ... frames,
+	//at most this many frames apart, zero retries on every frame
+	size_t max_retry_interval = 16;
+
+	//...unless its region grew by at least this factor (in area) since the last attempt, a plate that comes closer
+	//gets more pixels and is worth another try right away, zero disables it
+	double retry_growth = 1.5;
+
+	//tracks that have not been seen for more than this many frames are dropped
+	size_t max_missed_frames = 5;
+
+	//put a motion_gate in front of detection: frames where nothing changed in the regions of interest are skipped,
+	//and in the others only the changed parts are searched for plates - tracks outside of the changed parts don't age
+	bool motion_gating = false;
+	motion_gate_options motion;
+};
+
+//a plate followed across consecutive frames
+struct plate_track
+{
+	size_t id = 0;
+	size_t strategy_index = 0;
+
+	//region of the plate in the last frame it was seen in
+	cv::Rect region;
+
+	//best read so far
+	std::string plate_number;
+	int confidence = 0;
+	bool has_read = false;
+
+	size_t frames_seen = 0;
+	size_t missed_frames = 0;
+	size_t frames_since_ocr = 0;
+
+	//OCR attempts in a row that left the track without a stable read, and the region of the last attempt
+	size_t failed_reads = 0;
+	cv::Rect ocr_region;
+};
+
+//counters of the stream recognizer, mostly to see how much OCR work the tracking saves
+struct stream_stats
+{
+	size_t frames = 0;
+	size_t candidates = 0;
+	size_t ocr_calls = 0;
+	size_t reused_reads = 0;
+	size_t tracks_created = 0;
+
+	//OCR of unstable tracks put off by the retry backoff
+	size_t deferred_reads = 0;
+
+	//frames skipped by the motion gate, without any detection or OCR
+	size_t gated_frames = 0;
+};
+
+//recognizer for a video stream (a single camera), where the same plate stays in frame for many consecutive frames
+//plate candidates are matched to the tracks of the previous frames by the overlap of their regions,
+//and tesseract runs only for new tracks or tracks that don't have a confident read yet (with a backoff for those that keep failing)
+//note: not thread-safe, use one instance per stream (the underlying plate_recognizer can be shared)
+class plate_stream_recognizer
+{
+private:
+	std::shared_ptr<plate_recognizer> recognizer;
+	stream_options options;
+
+	motion_gate gate;
+	std::vector<cv::Rect> changed_regions;
+
+	std::vector<plate_track> tracks;
+	size_t next_track_id = 1;
+	stream_stats stats;
+
+	//pair candidates with existing tracks of the same strategy, best overlaps first
+	//returns index of the matched track per candidate (or -1 if the candidate is a new plate)
+	std::vector<int> match_candidates_to_tracks(const std::vector<plate_candidate>& candidates) const;
+
+	bool needs_ocr(const plate_track& track) const;
+
+	//detection on the frame, or just on its changed parts if motion gating is on - false if the gate says the frame can be skipped
+	template<class frame_type>
+	bool find_candidates(const frame_type& frame, std::vector<plate_candidate>& candidates);
+
+	//whether detection looked at the region in the current frame, only then does a track there age if it isn't found
+	bool was_searched(const cv::Rect& region) const;
+
+	//a frame the motion gate let go, nothing is reported for it
+	bool skip_frame();
+
+	//match the candidates of a frame to the tracks, OCR what needs it and report the reads of the frame
+	bool track_and_read(std::vector<plate_candidate>& candidates, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold);
+
+public:
+	explicit plate_stream_recognizer(std::shared_ptr<plate_recognizer> recognizer, const stream_options& options = stream_options());
+
+	//recognize plates in the next frame of the stream, the results have the same form as plate_recognizer::try_parse()
+	bool try_parse_frame(const cv::Mat& frame, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold = 35);
+
+	//same, for a frame in memory of the caller (see plate_recognizer::try_parse(const raw_frame&, ...))
+	bool try_parse_frame(const raw_frame& frame, std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence, int confidence_threshold = 35);
+
+	//forget all of the tracks (and the background of the motion gate), for example when the camera has been moved
+	void reset();
+
+	const std::vector<plate_track>& active_tracks() const { return tracks; }
+	const stream_stats& statistics() const { return stats; }
+};
+
+#endif // PLATE_STREAM_RECOGNIZER_H
@@ -14,22 +14,30 @@ struct possible_plate
 	//correction angle in degrees
 	double angle{};
 
-	explicit possible_plate(const std::vector<std::vector<cv::Point>>& contours)
+	//'sequence' holds indexes of the plate's characters in 'chars'
+	possible_plate(const std::vector<if_char>& chars, const std::vector<size_t>& sequence)
 	{
-		std::vector<if_char> maybe_chars;
+		//the characters are only looked at, so there is no need to copy their contours
+		std::vector<const if_char*> maybe_chars;
 
-		maybe_chars.reserve(contours.size());
+		maybe_chars.reserve(sequence.size());
 
-		for(auto& c : contours)
-			maybe_chars.emplace_back(c);
+		for(auto i : sequence)
+			maybe_chars.push_back(&chars[i]);
 
+		calculate_position(maybe_chars);
+	}
+
+private:
+	void calculate_position(std::vector<const if_char*>& maybe_chars)
+	{
 		//sort from left to right based on x position
 		std::sort(maybe_chars.begin(), maybe_chars.end(),
 		          //sort in ascending order
-		          [](const if_char& a, const if_char& b) { return a.center_x() < b.center_x(); });
+		          [](const if_char* a, const if_char* b) { return a->center_x() < b->center_x(); });
 
-		const auto first_char = maybe_chars[0];
-		const auto last_char = maybe_chars[maybe_chars.size() - 1];
+		const auto& first_char = *maybe_chars[0];
+		const auto& last_char = *maybe_chars[maybe_chars.size() - 1];
 
 		center = cv::Point2f((first_char.center_x() + last_char.center_x()) / 2.0,
 		                                (first_char.center_y() + last_char.center_y()) / 2.0);
@@ -37,8 +45,8 @@ struct possible_plate
 		width = int((last_char.bounding_rect.x + last_char.bounding_rect.width - first_char.bounding_rect.x) * 1.3);
 
 		auto total_char_heights = 0;
-		for(auto& matching_char : maybe_chars)
-			total_char_heights += matching_char.bounding_rect.height;
+		for(auto matching_char : maybe_chars)
+			total_char_heights += matching_char->bounding_rect.height;
 
 		const auto average_char_height = total_char_heights / maybe_chars.size();
 
@@ -48,5 +56,23 @@ struct possible_plate
 		const auto hypotenuse = first_char.distance_to(last_char);
 		angle = asin(opposite / hypotenuse) * (180.0 / M_PI);
 	}
+
+public:
+	//scale the position and size of the plate (the angle stays the same), used to map a plate found on a downscaled image
+	void rescale(const double factor)
+	{
+		if(factor == 1.0)
+			return;
+
+		center = cv::Point2f(static_cast<float>(center.x * factor), static_cast<float>(center.y * factor));
+		width = int(width * factor);
+		height = int(height * factor);
+	}
+
+	//axis aligned box around the (rotated) plate, in the coordinates of the source image
+	cv::Rect bounding_rect() const
+	{
+		return cv::RotatedRect(center, cv::Size2f(static_cast<float>(width), static_cast<float>(height)), static_cast<float>(angle)).boundingRect();
+	}
 };
 #endif // POSSIBLE_PLATE_HPP
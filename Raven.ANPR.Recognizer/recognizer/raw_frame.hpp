@@ -0,0 +1,101 @@
+#ifndef RAW_FRAME_HPP
+#define RAW_FRAME_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <opencv2/core.hpp>
+
+//pixel layouts plate_recognizer can take directly from a capture device
+enum class pixel_format
+{
+	bgr,
+	bgra,
+	rgb,
+	rgba,
+	gray,
+
+	//planar/semi-planar YUV 4:2:0, the full resolution Y plane comes first
+	nv12,
+	nv21,
+	i420,
+	yv12
+};
+
+//a frame in memory owned by the caller (a capture card buffer, for example), nothing is copied when it is wrapped
+//the memory has to stay valid until the call it is passed to returns
+//for the YUV formats only the Y plane is ever read - plate detection and OCR work on grayscale, so the chroma planes are not needed at all
+struct raw_frame
+{
+	const unsigned char* data = nullptr;
+	int width = 0;
+	int height = 0;
+
+	//bytes per row of the first plane (the Y plane of YUV formats), zero means rows are tightly packed
+	size_t stride = 0;
+
+	pixel_format format = pixel_format::bgr;
+
+	raw_frame() = default;
+
+	raw_frame(const unsigned char* data, const int width, const int height, const pixel_format format, const size_t stride = 0)
+		: data(data),
+		  width(width),
+		  height(height),
+		  stride(stride),
+		  format(format)
+	{
+	}
+
+	//bytes per pixel of the first plane
+	static int bytes_per_pixel(const pixel_format format)
+	{
+		switch(format)
+		{
+			case pixel_format::bgr:
+			case pixel_format::rgb:
+				return 3;
+			case pixel_format::bgra:
+			case pixel_format::rgba:
+				return 4;
+			default:
+				return 1;
+		}
+	}
+
+	bool is_yuv() const
+	{
+		return format == pixel_format::nv12 || format == pixel_format::nv21 ||
+			format == pixel_format::i420 || format == pixel_format::yv12;
+	}
+
+	size_t row_stride() const
+	{
+		return stride != 0 ? stride : static_cast<size_t>(width) * bytes_per_pixel(format);
+	}
+
+	void throw_if_invalid() const
+	{
+		if(data == nullptr || width <= 0 || height <= 0)
+			throw std::invalid_argument("Raw frame has no pixels (null data or empty size)");
+
+		if(row_stride() < static_cast<size_t>(width) * bytes_per_pixel(format))
+			throw std::invalid_argument("Raw frame stride is smaller than its row");
+	}
+
+	//cv::Mat header over the first plane (the whole image for packed formats, the Y plane for YUV ones), no pixels are copied
+	//the header is read-only by contract, the const is cast away only because cv::Mat has no const view
+	cv::Mat first_plane() const
+	{
+		return cv::Mat(height, width, CV_8UC(bytes_per_pixel(format)), const_cast<unsigned char*>(data), row_stride());
+	}
+
+	//the part of the frame inside 'region' (which has to lie within the frame), no pixels are copied
+	//only the first plane is cut - for YUV frames the result is a valid Y plane, but its chroma planes are not where they would be
+	//(which is fine as nothing reads them, see above)
+	raw_frame sub_frame(const cv::Rect& region) const
+	{
+		return raw_frame(data + region.y * row_stride() + static_cast<size_t>(region.x) * bytes_per_pixel(format), region.width, region.height, format, row_stride());
+	}
+};
+
+#endif // RAW_FRAME_HPP
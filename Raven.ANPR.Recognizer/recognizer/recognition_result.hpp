@@ -0,0 +1,258 @@
+#ifndef RECOGNITION_RESULT_HPP
+#define RECOGNITION_RESULT_HPP
+
+#include <opencv2/core.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "ocr_backend.hpp"
+#include "plate_candidate.hpp"
+
+//a plate number read from an image, with where it was found and how
+//the text is stored inline, so an entry owns no memory
+struct recognized_plate
+{
+	//longer reads are not plates, just OCR making things up
+	static constexpr size_t max_text_length = 23;
+
+	char text[max_text_length + 1] = {};
+	uint8_t text_length = 0;
+
+	int confidence = 0;
+
+	//where in the source image the plate was found
+	cv::Rect region;
+
+	//index of the strategy that found the plate, in the order the strategies were given to plate_recognizer
+	size_t strategy_index = 0;
+
+	//confidence (0-100) of each character of the text, char_confidence_count is zero if the OCR backend doesn't report them
+	uint8_t char_confidences[max_text_length] = {};
+	uint8_t char_confidence_count = 0;
+
+	std::string number() const { return std::string(text, text_length); }
+};
+
+//the plates read from one image: a fixed number of entries, one per plate number (the most confident read of it wins)
+//all of the memory is allocated up front, so once the result is reused between calls, recognizing an image allocates nothing for it
+//duplicates are found through a small open addressing hash table of the texts, not by scanning the entries
+//if more distinct numbers are read than the capacity, the least confident ones are dropped (see dropped_count()),
+//reads longer than recognized_plate::max_text_length are not kept either (see too_long_count()) - overflowed() tells if any were lost
+//note: not thread-safe, one result per thread (or per call)
+class recognition_result
+{
+public:
+	static constexpr size_t default_capacity = 32;
+
+private:
+	std::vector<recognized_plate> entries;
+	size_t count = 0;
+	size_t capacity;
+	size_t dropped = 0;
+	size_t too_long = 0;
+
+	//entry index + 1 per slot, zero is an empty slot - twice (or more) as many slots as entries keep the probes short
+	std::vector<uint16_t> slots;
+	size_t slot_mask;
+
+	static uint32_t hash(const char* text, const size_t length)
+	{
+		auto value = 2166136261u;
+		for(size_t i = 0; i < length; i++)
+			value = (value ^ static_cast<unsigned char>(text[i])) * 16777619u;
+		return value;
+	}
+
+	//slot of the text, or of the empty slot where it would go
+	size_t find_slot(const char* text, const size_t length) const
+	{
+		for(auto slot = hash(text, length) & slot_mask; ; slot = (slot + 1) & slot_mask)
+		{
+			if(slots[slot] == 0)
+				return slot;
+
+			const auto& entry = entries[slots[slot] - 1];
+			if(entry.text_length == length && std::memcmp(entry.text, text, length) == 0)
+				return slot;
+		}
+	}
+
+	//remove an entry (and its slot), the last entry takes its place
+	void remove(const size_t index)
+	{
+		const auto& removed = entries[index];
+		auto slot = find_slot(removed.text, removed.text_length);
+		slots[slot] = 0;
+
+		//linear probing - the entries after the hole that would not be found anymore have to move up
+		for(auto next = (slot + 1) & slot_mask; slots[next] != 0; next = (next + 1) & slot_mask)
+		{
+			const auto& moved = entries[slots[next] - 1];
+			const auto home = hash(moved.text, moved.text_length) & slot_mask;
+			const auto distance_to_hole = (next - home) & slot_mask;
+			const auto distance_to_next = (next - slot) & slot_mask;
+			if(distance_to_hole >= distance_to_next)
+			{
+				slots[slot] = slots[next];
+				slots[next] = 0;
+				slot = next;
+			}
+		}
+
+		const auto last = count - 1;
+		if(index != last)
+		{
+			entries[index] = entries[last];
+			slots[find_slot(entries[index].text, entries[index].text_length)] = static_cast<uint16_t>(index + 1);
+		}
+		count--;
+	}
+
+	static void fill(recognized_plate& entry, const ocr_read& read, const cv::Rect& region, const size_t strategy_index)
+	{
+		entry.text_length = static_cast<uint8_t>(read.text.size());
+		std::memcpy(entry.text, read.text.data(), read.text.size());
+		entry.text[read.text.size()] = '\0';
+		entry.confidence = read.confidence;
+		entry.region = region;
+		entry.strategy_index = strategy_index;
+
+		entry.char_confidence_count = read.char_confidences.size() == read.text.size() ? static_cast<uint8_t>(read.text.size()) : 0;
+		for(size_t i = 0; i < entry.char_confidence_count; i++)
+			entry.char_confidences[i] = static_cast<uint8_t>(std::clamp(read.char_confidences[i], 0, 100));
+	}
+
+public:
+	explicit recognition_result(const size_t capacity = default_capacity)
+		: capacity(std::clamp<size_t>(capacity, 1, UINT16_MAX - 1))
+	{
+		entries.resize(this->capacity);
+
+		size_t slot_count = 1;
+		while(slot_count < this->capacity * 2)
+			slot_count *= 2;
+		slots.assign(slot_count, 0);
+		slot_mask = slot_count - 1;
+	}
+
+	//forget the entries, the memory is kept for the next image
+	void clear()
+	{
+		std::fill(slots.begin(), slots.end(), uint16_t(0));
+		count = 0;
+		dropped = 0;
+		too_long = 0;
+	}
+
+	//add a read, a number that is already there is replaced only by a more confident read of it
+	//false if the read was not kept (a less confident duplicate, too long, or less confident than everything in a full result)
+	bool add(const ocr_read& read, const cv::Rect& region = cv::Rect(), const size_t strategy_index = 0)
+	{
+		if(read.text.empty())
+			return false;
+
+		if(read.text.size() > recognized_plate::max_text_length)
+		{
+			too_long++;
+			return false;
+		}
+
+		const auto slot = find_slot(read.text.data(), read.text.size());
+		if(slots[slot] != 0)
+		{
+			auto& existing = entries[slots[slot] - 1];
+			if(existing.confidence >= read.confidence)
+				return false;
+
+			fill(existing, read, region, strategy_index);
+			return true;
+		}
+
+		if(count == capacity)
+		{
+			//full, the new read pushes out the least confident entry (if it is better than that)
+			const auto weakest = std::min_element(entries.begin(), entries.begin() + count,
+				[](const recognized_plate& a, const recognized_plate& b) { return a.confidence < b.confidence; }) - entries.begin();
+			dropped++;
+			if(entries[weakest].confidence >= read.confidence)
+				return false;
+
+			remove(static_cast<size_t>(weakest));
+			return add(read, region, strategy_index);
+		}
+
+		fill(entries[count], read, region, strategy_index);
+		slots[slot] = static_cast<uint16_t>(count + 1);
+		count++;
+		return true;
+	}
+
+	//add the reads of the candidates (the same order, see plate_recognizer::execute_ocr()) that succeeded and pass the threshold
+	void add(const std::vector<plate_candidate>& candidates, const std::vector<ocr_read>& reads, const int confidence_threshold)
+	{
+		for(size_t i = 0; i < reads.size(); i++)
+			if(reads[i].succeeded && reads[i].confidence >= confidence_threshold)
+				add(reads[i], i < candidates.size() ? candidates[i].region : cv::Rect(), i < candidates.size() ? candidates[i].strategy_index : 0);
+	}
+
+	//the most confident first, reads of the same confidence stay in the order they were added
+	//(the hash table keeps indexes of the entries, so it is rebuilt - there are only a few of them)
+	void sort_by_confidence()
+	{
+		std::stable_sort(entries.begin(), entries.begin() + count,
+			[](const recognized_plate& a, const recognized_plate& b) { return a.confidence > b.confidence; });
+
+		std::fill(slots.begin(), slots.end(), uint16_t(0));
+		for(size_t i = 0; i < count; i++)
+			slots[find_slot(entries[i].text, entries[i].text_length)] = static_cast<uint16_t>(i + 1);
+	}
+
+	//the entry of a number, null if it was not read
+	const recognized_plate* find(const std::string& number) const
+	{
+		if(number.size() > recognized_plate::max_text_length)
+			return nullptr;
+
+		const auto slot = find_slot(number.data(), number.size());
+		return slots[slot] != 0 ? &entries[slots[slot] - 1] : nullptr;
+	}
+
+	//the results in the old form, numbers already there with at least the same confidence are not added again
+	void append_to(std::multimap<int, std::string, std::greater<int>>& parsed_numbers_by_confidence) const
+	{
+		for(size_t i = 0; i < count; i++)
+		{
+			const auto& entry = entries[i];
+
+			//the map is ordered by confidence (highest first), only the front of it can have the number at the same or a higher one
+			auto exists = false;
+			for(auto it = parsed_numbers_by_confidence.begin(); it != parsed_numbers_by_confidence.end() && it->first >= entry.confidence && !exists; ++it)
+				exists = it->second.size() == entry.text_length && std::memcmp(it->second.data(), entry.text, entry.text_length) == 0;
+
+			if(!exists)
+				parsed_numbers_by_confidence.emplace(entry.confidence, entry.number());
+		}
+	}
+
+	const recognized_plate* begin() const { return entries.data(); }
+	const recognized_plate* end() const { return entries.data() + count; }
+	const recognized_plate& operator[](const size_t i) const { return entries[i]; }
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	size_t max_size() const { return capacity; }
+
+	//distinct numbers that did not fit since the last clear()
+	size_t dropped_count() const { return dropped; }
+
+	//reads too long to be kept since the last clear()
+	size_t too_long_count() const { return too_long; }
+
+	//whether any read was lost since the last clear(), for the first reason or the second
+	bool overflowed() const { return dropped > 0 || too_long > 0; }
+};
+
+#endif // RECOGNITION_RESULT_HPP
@@ -0,0 +1,287 @@
+#ifndef RECOGNIZER_METRICS_HPP
+#define RECOGNIZER_METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+//stages of plate_recognizer that are timed when the metrics are enabled
+enum class recognizer_stage
+{
+	decode,		//reading and decoding the image file (try_parse() with a path and try_parse_batch())
+	detect,		//a detection pass of the strategies over a frame, cropping included (the cascade makes one pass per strategy)
+	crop,		//cropping of a single candidate (inside a strategy)
+	ocr,		//tesseract on a single candidate
+	merge,		//merging the reads of a frame into the results
+	total,		//a whole try_parse() call
+	count
+};
+
+inline const char* to_string(const recognizer_stage stage)
+{
+	switch(stage)
+	{
+		case recognizer_stage::decode: return "decode";
+		case recognizer_stage::detect: return "detect";
+		case recognizer_stage::crop: return "crop";
+		case recognizer_stage::ocr: return "ocr";
+		case recognizer_stage::merge: return "merge";
+		case recognizer_stage::total: return "total";
+		default: return "unknown";
+	}
+}
+
+//aggregates of a latency histogram at the time it was polled (all of the times are in microseconds)
+struct latency_summary
+{
+	size_t count = 0;
+	double mean = 0;
+	double p50 = 0;
+	double p90 = 0;
+	double p99 = 0;
+	double max = 0;
+
+	nlohmann::json to_json() const
+	{
+		return nlohmann::json {
+			{ "count", count },
+			{ "mean_us", mean },
+			{ "p50_us", p50 },
+			{ "p90_us", p90 },
+			{ "p99_us", p99 },
+			{ "max_us", max }
+		};
+	}
+};
+
+//lock-free histogram of latencies with logarithmic buckets (4 per power of two, so percentiles are within ~19% of the real value)
+//recording is a few relaxed atomic increments, so it can be called from any thread on the hot path
+class latency_histogram
+{
+private:
+	static constexpr size_t buckets_per_octave = 4;
+	static constexpr size_t bucket_count = 40 * buckets_per_octave; //up to 2^40 ns (about 18 minutes)
+
+	std::array<std::atomic<uint64_t>, bucket_count> buckets{};
+	std::atomic<uint64_t> total_ns{0};
+	std::atomic<uint64_t> max_ns{0};
+
+	static size_t bucket_of(const uint64_t ns)
+	{
+		if(ns <= 1)
+			return 0;
+		const auto bucket = static_cast<size_t>(std::log2(static_cast<double>(ns)) * buckets_per_octave);
+		return bucket < bucket_count ? bucket : bucket_count - 1;
+	}
+
+	//upper bound of a bucket, in nanoseconds
+	static double upper_bound_of(const size_t bucket)
+	{
+		return std::exp2(static_cast<double>(bucket + 1) / buckets_per_octave);
+	}
+
+public:
+	void record(const std::chrono::nanoseconds elapsed)
+	{
+		const auto ns = static_cast<uint64_t>(elapsed.count() > 0 ? elapsed.count() : 0);
+		buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+		total_ns.fetch_add(ns, std::memory_order_relaxed);
+
+		auto current_max = max_ns.load(std::memory_order_relaxed);
+		while(ns > current_max && !max_ns.compare_exchange_weak(current_max, ns, std::memory_order_relaxed))
+		{
+		}
+	}
+
+	latency_summary summary() const
+	{
+		std::array<uint64_t, bucket_count> counts;
+		uint64_t count = 0;
+		for(size_t i = 0; i < bucket_count; i++)
+		{
+			counts[i] = buckets[i].load(std::memory_order_relaxed);
+			count += counts[i];
+		}
+
+		latency_summary result;
+		result.count = static_cast<size_t>(count);
+		if(count == 0)
+			return result;
+
+		const auto max = static_cast<double>(max_ns.load(std::memory_order_relaxed));
+		const auto percentile = [&](const double p)
+		{
+			const auto rank = static_cast<uint64_t>(std::ceil(p * count));
+			uint64_t seen = 0;
+			for(size_t i = 0; i < bucket_count; i++)
+			{
+				seen += counts[i];
+				if(seen >= rank)
+					return std::min(upper_bound_of(i), max) / 1000.0;
+			}
+			return max / 1000.0;
+		};
+
+		result.mean = static_cast<double>(total_ns.load(std::memory_order_relaxed)) / count / 1000.0;
+		result.p50 = percentile(0.50);
+		result.p90 = percentile(0.90);
+		result.p99 = percentile(0.99);
+		result.max = max / 1000.0;
+		return result;
+	}
+
+	void reset()
+	{
+		for(auto& bucket : buckets)
+			bucket.store(0, std::memory_order_relaxed);
+		total_ns.store(0, std::memory_order_relaxed);
+		max_ns.store(0, std::memory_order_relaxed);
+	}
+};
+
+//everything plate_recognizer measures about itself when recognizer_options::enable_metrics is on
+//the counters are cumulative since the recognizer was created (or since the last reset()), poll them with to_json()
+class recognizer_metrics
+{
+private:
+	std::array<latency_histogram, static_cast<size_t>(recognizer_stage::count)> stages;
+
+	//per strategy (in the order the strategies were registered)
+	std::vector<std::unique_ptr<latency_histogram>> strategy_latency;
+	std::unique_ptr<std::atomic<uint64_t>[]> strategy_candidates;
+
+	std::atomic<uint64_t> frames{0};
+	std::atomic<uint64_t> ocr_calls{0};
+	std::atomic<uint64_t> ocr_hits{0};
+
+public:
+	explicit recognizer_metrics(const size_t strategy_count)
+		: strategy_candidates(new std::atomic<uint64_t>[strategy_count])
+	{
+		for(size_t i = 0; i < strategy_count; i++)
+		{
+			strategy_latency.push_back(std::make_unique<latency_histogram>());
+			strategy_candidates[i].store(0);
+		}
+	}
+
+	recognizer_metrics(const recognizer_metrics& other) = delete;
+	recognizer_metrics& operator=(const recognizer_metrics& other) = delete;
+
+	void record_stage(const recognizer_stage stage, const std::chrono::nanoseconds elapsed)
+	{
+		stages[static_cast<size_t>(stage)].record(elapsed);
+	}
+
+	void record_strategy(const size_t strategy_index, const std::chrono::nanoseconds elapsed, const size_t candidates)
+	{
+		strategy_latency[strategy_index]->record(elapsed);
+		strategy_candidates[strategy_index].fetch_add(candidates, std::memory_order_relaxed);
+	}
+
+	void record_frame() { frames.fetch_add(1, std::memory_order_relaxed); }
+
+	//a hit is an OCR call that produced a read
+	void record_ocr(const bool hit)
+	{
+		ocr_calls.fetch_add(1, std::memory_order_relaxed);
+		if(hit)
+			ocr_hits.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	latency_summary stage_latency(const recognizer_stage stage) const
+	{
+		return stages[static_cast<size_t>(stage)].summary();
+	}
+
+	latency_summary strategy_latency_of(const size_t strategy_index) const
+	{
+		return strategy_latency[strategy_index]->summary();
+	}
+
+	size_t candidates_of(const size_t strategy_index) const
+	{
+		return static_cast<size_t>(strategy_candidates[strategy_index].load(std::memory_order_relaxed));
+	}
+
+	size_t frame_count() const { return static_cast<size_t>(frames.load(std::memory_order_relaxed)); }
+	size_t ocr_call_count() const { return static_cast<size_t>(ocr_calls.load(std::memory_order_relaxed)); }
+	size_t ocr_hit_count() const { return static_cast<size_t>(ocr_hits.load(std::memory_order_relaxed)); }
+
+	double ocr_hit_rate() const
+	{
+		const auto calls = ocr_call_count();
+		return calls > 0 ? static_cast<double>(ocr_hit_count()) / calls : 0.0;
+	}
+
+	nlohmann::json to_json() const
+	{
+		nlohmann::json result;
+		result["frames"] = frame_count();
+		result["ocr_calls"] = ocr_call_count();
+		result["ocr_hits"] = ocr_hit_count();
+		result["ocr_hit_rate"] = ocr_hit_rate();
+
+		for(size_t i = 0; i < stages.size(); i++)
+			result["stages"][to_string(static_cast<recognizer_stage>(i))] = stages[i].summary().to_json();
+
+		result["strategies"] = nlohmann::json::array();
+		for(size_t i = 0; i < strategy_latency.size(); i++)
+		{
+			auto strategy = strategy_latency[i]->summary().to_json();
+			strategy["candidates"] = candidates_of(i);
+			result["strategies"].push_back(strategy);
+		}
+
+		return result;
+	}
+
+	void reset()
+	{
+		for(auto& stage : stages)
+			stage.reset();
+		for(size_t i = 0; i < strategy_latency.size(); i++)
+		{
+			strategy_latency[i]->reset();
+			strategy_candidates[i].store(0, std::memory_order_relaxed);
+		}
+		frames.store(0, std::memory_order_relaxed);
+		ocr_calls.store(0, std::memory_order_relaxed);
+		ocr_hits.store(0, std::memory_order_relaxed);
+	}
+};
+
+//times the scope it lives in, does nothing (not even reading the clock) when there are no metrics to record to
+class stage_timer
+{
+private:
+	recognizer_metrics* metrics;
+	recognizer_stage stage;
+	std::chrono::steady_clock::time_point started;
+
+public:
+	stage_timer(recognizer_metrics* metrics, const recognizer_stage stage)
+		: metrics(metrics),
+		  stage(stage)
+	{
+		if(metrics != nullptr)
+			started = std::chrono::steady_clock::now();
+	}
+
+	stage_timer(const stage_timer& other) = delete;
+	stage_timer& operator=(const stage_timer& other) = delete;
+
+	~stage_timer()
+	{
+		if(metrics != nullptr)
+			metrics->record_stage(stage, std::chrono::steady_clock::now() - started);
+	}
+};
+
+#endif // RECOGNIZER_METRICS_HPP
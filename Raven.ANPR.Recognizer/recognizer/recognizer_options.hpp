@@ -0,0 +1,57 @@
+#ifndef RECOGNIZER_OPTIONS_HPP
+#define RECOGNIZER_OPTIONS_HPP
+
+#include <cstddef>
+
+//tuning knobs of plate_recognizer, the defaults are meant to be sensible for most cases
+struct recognizer_options
+{
+	//the most tesseract engines to create (each one can OCR a single candidate at a time)
+	//zero means one engine per hardware thread, engines beyond the first are created only when that many candidates are OCR-ed at once
+	size_t ocr_pool_size = 0;
+
+	//when enabled, plate finder strategies run as independent tasks
+	//(detection latency becomes the latency of the slowest strategy instead of the sum of all of them)
+	//strategies must not keep mutable state between calls for this to be safe
+	bool parallel_strategies = false;
+
+	//candidates whose regions overlap a bigger candidate of the same strategy by at least this intersection-over-union are not OCR-ed
+	//(it is most likely the same plate found twice), anything above 1.0 disables the suppression
+	double candidate_overlap_threshold = 0.8;
+
+	//multi-scale detection: strategies look for plates on a grayscale frame downscaled so that a plate of
+	//'expected_plate_height' pixels (in the source frame) ends up 'min_detection_plate_height' pixels high,
+	//candidates are still cropped from the full resolution frame, so OCR quality does not suffer
+	//zero expected height disables the downscaling (detection runs at full resolution)
+	double expected_plate_height = 0;
+	double min_detection_plate_height = 24;
+
+	//when nothing is found on the downscaled frame, try again at twice the scale until full resolution is reached
+	//(small or distant plates may not survive the downscaling)
+	bool escalate_detection_scale = true;
+
+	//cascade mode of try_parse(): strategies run from the cheapest one (by measured time), candidates are OCR-ed
+	//from the most plate-like one, and the work stops at the first read that has at least 'cascade_target_confidence'
+	//and the expected length (zero min/max length means any length is fine)
+	bool cascade = false;
+	int cascade_target_confidence = 90;
+	size_t expected_plate_length_min = 0;
+	size_t expected_plate_length_max = 0;
+
+	//width/height of a typical plate, candidates closer to it are OCR-ed first in the cascade mode
+	//(about 4.7 for european plates and 2 for north american ones), zero keeps the order of the strategies
+	double expected_plate_aspect_ratio = 4.0;
+
+	//collect per-stage latency histograms, candidate counts and OCR hit rate (see plate_recognizer::metrics())
+	//when disabled nothing is measured at all, not even the clock is read
+	bool enable_metrics = false;
+
+	//try_parse_batch() pipeline: how many workers each stage gets and how many items can wait between the stages
+	//zero OCR workers means one worker per engine in the OCR pool
+	size_t batch_decode_workers = 1;
+	size_t batch_detect_workers = 1;
+	size_t batch_ocr_workers = 0;
+	size_t batch_queue_capacity = 16;
+};
+
+#endif // RECOGNIZER_OPTIONS_HPP
@@ -0,0 +1,64 @@
+#include "tesseract_ocr_backend.h"
+#include <tesseract/resultiterator.h>
+#include <stdexcept>
+
+namespace
+{
+	//only these survive in a plate number
+	bool is_plate_char(const char c)
+	{
+		return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9');
+	}
+}
+
+tesseract_ocr_backend::tesseract_ocr_backend(const size_t pool_size)
+	: engines(std::make_shared<ocr_engine_pool>(pool_size))
+{
+}
+
+tesseract_ocr_backend::tesseract_ocr_backend(std::shared_ptr<ocr_engine_pool> engines)
+	: engines(std::move(engines))
+{
+	if(this->engines == nullptr)
+		throw std::invalid_argument("tesseract_ocr_backend needs an engine pool");
+}
+
+bool tesseract_ocr_backend::try_execute_ocr(tesseract::TessBaseAPI& ocr_api, const cv::Mat& plate_image, ocr_read& read)
+{
+	//normalized candidates are 8 bit grayscale, but any packed 8 bit image works (and rows may be padded)
+	ocr_api.SetImage(plate_image.data, plate_image.cols, plate_image.rows, plate_image.channels(), static_cast<int>(plate_image.step));
+	const std::unique_ptr<char[]> text(ocr_api.GetUTF8Text());
+	read.confidence = ocr_api.MeanTextConf();
+	if(text == nullptr || text[0] == '\0')
+		return read.succeeded = false;
+
+	//remove whitespaces and irrelevant characters from detected plate number
+	//this will mitigate somewhat OCR detecting garbage in case of visual artifacts (after license plate detection)
+	for(auto c = text.get(); *c != '\0'; ++c)
+		if(is_plate_char(*c))
+			read.text.push_back(*c);
+
+	//the recognition already ran, walking its symbols is cheap
+	const std::unique_ptr<tesseract::ResultIterator> symbols(ocr_api.GetIterator());
+	if(symbols != nullptr)
+	{
+		do
+		{
+			const std::unique_ptr<char[]> symbol(symbols->GetUTF8Text(tesseract::RIL_SYMBOL));
+			if(symbol != nullptr && is_plate_char(symbol[0]) && symbol[1] == '\0')
+				read.char_confidences.push_back(static_cast<int>(symbols->Confidence(tesseract::RIL_SYMBOL)));
+		}
+		while(symbols->Next(tesseract::RIL_SYMBOL));
+	}
+
+	if(read.char_confidences.size() != read.text.size())
+		read.char_confidences.clear();
+
+	return read.succeeded = read.text.size() > 3;
+}
+
+bool tesseract_ocr_backend::try_read(const plate_candidate& candidate, ocr_read& read)
+{
+	const auto engine = engines->acquire();
+	return try_execute_ocr(*engine, candidate.image, read);
+}
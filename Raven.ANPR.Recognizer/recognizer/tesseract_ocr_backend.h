@@ -0,0 +1,29 @@
+#ifndef TESSERACT_OCR_BACKEND_H
+#define TESSERACT_OCR_BACKEND_H
+
+#include <tesseract/baseapi.h>
+#include <memory>
+#include "ocr_backend.hpp"
+#include "ocr_engine_pool.h"
+
+//OCR of the whole plate with tesseract, every read checks out its own engine from the pool
+class tesseract_ocr_backend final : public ocr_backend
+{
+private:
+	std::shared_ptr<ocr_engine_pool> engines;
+
+public:
+	//pool_size of zero means "at most one engine per hardware thread" (see ocr_engine_pool)
+	explicit tesseract_ocr_backend(size_t pool_size = 0);
+	explicit tesseract_ocr_backend(std::shared_ptr<ocr_engine_pool> engines);
+
+	//OCR a single plate image (see candidate_normalization) with the given engine, only alphanumeric characters are kept in read.text
+	//the per-character confidences are filled in only if tesseract's symbols line up with the filtered text
+	static bool try_execute_ocr(tesseract::TessBaseAPI& ocr_api, const cv::Mat& plate_image, ocr_read& read);
+
+	bool try_read(const plate_candidate& candidate, ocr_read& read) override;
+
+	size_t concurrency() const override { return engines->size(); }
+};
+
+#endif // TESSERACT_OCR_BACKEND_H
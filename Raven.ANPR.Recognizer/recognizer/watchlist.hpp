@@ -0,0 +1,291 @@
+#ifndef WATCHLIST_HPP
+#define WATCHLIST_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+//a plate on the watchlist
+struct watchlist_entry
+{
+	std::string number;
+
+	//whatever the list says about the plate (stolen, expired insurance, ...), it is just passed through to the matches
+	std::string label;
+};
+
+//a listed plate that matches a read
+struct watchlist_match
+{
+	std::string number;
+	std::string label;
+
+	//edit distance between the read and the listed plate, with the characters OCR confuses counted as equal (see watchlist::fold())
+	int distance = 0;
+
+	//the read is the listed plate character for character (apart from spaces, dashes and letter case)
+	bool exact = false;
+};
+
+//immutable index of a watchlist for fuzzy lookups of plate reads
+//
+//OCR mixes up characters that look alike (0/O, 8/B, 1/I, ...), so both the listed plates and the reads are first folded:
+//every group of look-alike characters is replaced by one of them, and those mix-ups cost nothing
+//what is left (a missing, extra or really misread character) is found with a deletion neighbourhood index: every listed plate
+//is indexed under itself and every string that is left after deleting up to 'max_distance' of its characters, a read looks up
+//the same deletions of itself - two strings within 'max_distance' edits always share one of them
+//the hits are verified with a real edit distance, so the neighbourhood only has to be fast and not exact
+//
+//the index is one sorted array of 8 byte (32 bit hash of a deletion, plate index) keys, a lookup is a binary search per deletion
+//the neighbourhood of a plate of n characters has 1 + n keys at max_distance 1 and 1 + n + n(n-1)/2 at 2 - for a few million
+//plates that is a couple of hundred MB at 1, and about four times as much at 2
+//1 is usually enough, the folding already takes care of the common mix-ups
+class watchlist
+{
+private:
+	std::vector<watchlist_entry> entries;
+	int max_distance;
+
+	//hash of a deletion in the upper 32 bits, index of the entry in the lower ones, sorted
+	//(hash collisions only cost a verification, so 32 bits are plenty)
+	std::vector<uint64_t> neighbourhood;
+
+	static constexpr size_t none = static_cast<size_t>(-1);
+
+	//FNV-1a of 'text' without the characters at 'skip1' and 'skip2', with its length mixed in so deletions of different counts
+	//don't collide
+	static uint32_t hash_without(const std::string& text, const size_t skip1, const size_t skip2)
+	{
+		auto hash = 14695981039346656037ull;
+		size_t length = 0;
+		for(size_t i = 0; i < text.size(); i++)
+		{
+			if(i == skip1 || i == skip2)
+				continue;
+			hash = (hash ^ static_cast<unsigned char>(text[i])) * 1099511628211ull;
+			length++;
+		}
+		hash = (hash ^ length) * 1099511628211ull;
+		return static_cast<uint32_t>(hash ^ (hash >> 32));
+	}
+
+	//calls 'visit(hash)' for the text and all of its deletions of up to 'distance' characters (some may repeat)
+	template<typename TVisit>
+	static void for_each_deletion(const std::string& text, const int distance, TVisit&& visit)
+	{
+		visit(hash_without(text, none, none));
+		if(distance < 1)
+			return;
+
+		for(size_t i = 0; i < text.size(); i++)
+		{
+			visit(hash_without(text, i, none));
+			if(distance < 2)
+				continue;
+
+			for(size_t j = i + 1; j < text.size(); j++)
+				visit(hash_without(text, i, j));
+		}
+	}
+
+	//Levenshtein distance, or max + 1 once it is known to be over 'max'
+	static int bounded_distance(const std::string& a, const std::string& b, const int max)
+	{
+		const auto length_difference = static_cast<int>(a.size()) - static_cast<int>(b.size());
+		if(std::abs(length_difference) > max)
+			return max + 1;
+
+		//plates are short, two rows on the stack would do, but a read can be anything the OCR made up
+		std::vector<int> previous(b.size() + 1), current(b.size() + 1);
+		for(size_t j = 0; j <= b.size(); j++)
+			previous[j] = static_cast<int>(j);
+
+		for(size_t i = 1; i <= a.size(); i++)
+		{
+			current[0] = static_cast<int>(i);
+			auto row_min = current[0];
+			for(size_t j = 1; j <= b.size(); j++)
+			{
+				const auto substitution = previous[j - 1] + (a[i - 1] == b[j - 1] ? 0 : 1);
+				current[j] = std::min({ previous[j] + 1, current[j - 1] + 1, substitution });
+				row_min = std::min(row_min, current[j]);
+			}
+
+			if(row_min > max)
+				return max + 1;
+			std::swap(previous, current);
+		}
+
+		return std::min(previous[b.size()], max + 1);
+	}
+
+	watchlist(std::vector<watchlist_entry> list, const int max_distance)
+		: entries(std::move(list)),
+		  max_distance(max_distance)
+	{
+		if(max_distance < 0 || max_distance > 2)
+			throw std::invalid_argument("The watchlist supports edit distances of 0 to 2");
+		if(entries.size() > UINT32_MAX)
+			throw std::invalid_argument("The watchlist is too big");
+
+		for(size_t i = 0; i < entries.size(); i++)
+			for_each_deletion(fold(normalize(entries[i].number)), max_distance,
+				[&](const uint32_t hash) { neighbourhood.push_back(static_cast<uint64_t>(hash) << 32 | i); });
+
+		std::sort(neighbourhood.begin(), neighbourhood.end());
+		neighbourhood.erase(std::unique(neighbourhood.begin(), neighbourhood.end()), neighbourhood.end());
+		neighbourhood.shrink_to_fit();
+	}
+
+public:
+	//build the index, this takes a while for a big list - do it before swapping the list in (see watchlist_matcher::reload())
+	static std::shared_ptr<const watchlist> build(std::vector<watchlist_entry> entries, const int max_distance = 1)
+	{
+		return std::shared_ptr<const watchlist>(new watchlist(std::move(entries), max_distance));
+	}
+
+	//upper case letters and digits only, plates are written with all sorts of spaces and dashes
+	static std::string normalize(const std::string& number)
+	{
+		std::string result;
+		result.reserve(number.size());
+		for(const auto c : number)
+			if(std::isalnum(static_cast<unsigned char>(c)))
+				result.push_back(static_cast<char>(std::toupper(static_cast<unsigned char>(c))));
+		return result;
+	}
+
+	//the characters OCR tends to mix up, mapped to one of their group
+	static char fold(const char c)
+	{
+		switch(c)
+		{
+			case 'O':
+			case 'Q':
+			case 'D':
+				return '0';
+			case 'I':
+			case 'L':
+				return '1';
+			case 'Z':
+				return '2';
+			case 'S':
+				return '5';
+			case 'G':
+				return '6';
+			case 'B':
+				return '8';
+			default:
+				return c;
+		}
+	}
+
+	static std::string fold(const std::string& normalized)
+	{
+		std::string result(normalized);
+		for(auto& c : result)
+			c = fold(c);
+		return result;
+	}
+
+	//listed plates within the edit distance of the read, the closest first
+	//false if there are none
+	bool find(const std::string& read, std::vector<watchlist_match>& matches) const
+	{
+		matches.clear();
+		const auto plain = normalize(read);
+		if(plain.empty())
+			return false;
+		const auto folded = fold(plain);
+
+		std::vector<uint32_t> hits;
+		for_each_deletion(folded, max_distance, [&](const uint32_t hash)
+		{
+			const auto first = static_cast<uint64_t>(hash) << 32;
+			for(auto it = std::lower_bound(neighbourhood.begin(), neighbourhood.end(), first);
+				it != neighbourhood.end() && (*it >> 32) == hash; ++it)
+				hits.push_back(static_cast<uint32_t>(*it));
+		});
+
+		std::sort(hits.begin(), hits.end());
+		hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+
+		//the normalized and folded numbers are not kept, they are cheap to redo for the few hits and would double the memory
+		for(const auto index : hits)
+		{
+			const auto listed = normalize(entries[index].number);
+			const auto distance = bounded_distance(folded, fold(listed), max_distance);
+			if(distance > max_distance)
+				continue;
+
+			watchlist_match match;
+			match.number = entries[index].number;
+			match.label = entries[index].label;
+			match.distance = distance;
+			match.exact = plain == listed;
+			matches.push_back(std::move(match));
+		}
+
+		std::sort(matches.begin(), matches.end(), [](const watchlist_match& a, const watchlist_match& b)
+		{
+			return a.distance != b.distance ? a.distance < b.distance : a.exact > b.exact;
+		});
+		return !matches.empty();
+	}
+
+	size_t size() const { return entries.size(); }
+	int edit_distance() const { return max_distance; }
+};
+
+//the watchlist the recognition threads check their reads against, the list can be replaced while they do
+//a reload builds the new index on the side and then just swaps the pointer to it under a mutex, lookups never wait for a build -
+//the mutex is held only to copy (or swap) the pointer, not for the lookup itself
+//a lookup that started before the swap finishes on the old list (it holds a reference to it), the next one sees the new list
+//note: thread-safe
+class watchlist_matcher
+{
+private:
+	std::shared_ptr<const watchlist> current;
+	mutable std::mutex sync;
+
+public:
+	explicit watchlist_matcher(std::shared_ptr<const watchlist> list = watchlist::build({}))
+		: current(std::move(list))
+	{
+		if(current == nullptr)
+			throw std::invalid_argument("watchlist_matcher needs a watchlist (it may be empty)");
+	}
+
+	void reload(std::shared_ptr<const watchlist> list)
+	{
+		if(list == nullptr)
+			throw std::invalid_argument("watchlist_matcher needs a watchlist (it may be empty)");
+
+		//the old list is released after the lock, freeing a big index doesn't hold up the lookups
+		{
+			std::lock_guard<std::mutex> lock(sync);
+			current.swap(list);
+		}
+	}
+
+	//the list as it is right now, it stays valid (and unchanged) for as long as the caller holds it
+	std::shared_ptr<const watchlist> snapshot() const
+	{
+		std::lock_guard<std::mutex> lock(sync);
+		return current;
+	}
+
+	bool find(const std::string& read, std::vector<watchlist_match>& matches) const
+	{
+		return snapshot()->find(read, matches);
+	}
+};
+
+#endif // WATCHLIST_HPP
@@ -5,16 +5,50 @@
 #include <memory>
 #include <recognizer/plate_finder_by_geometry.hpp>
 #include "recognizer/plate_finder_by_rectangle.hpp"
+#include "recognizer/plate_stream_recognizer.h"
+#include "recognizer/char_grid.hpp"
+#include "recognizer/candidate_consolidation.hpp"
+#include "recognizer/char_classifier_backend.hpp"
+#include "recognizer/contrast_kernel.hpp"
+#include "recognizer/motion_gate.hpp"
+#include "recognizer/watchlist.hpp"
+#include "recognizer/recognition_result.hpp"
+#include "recognizer/tesseract_ocr_backend.h"
+#include "persister/async_plate_persister.hpp"
+#include "persister/in_memory_plate_sink.hpp"
+#include "persister/plate_journal.h"
+#include "persister/plate_journal_replayer.h"
+#include "persister/sighting_index.hpp"
+#include <filesystem>
+#include <future>
+#include <random>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <thread>
 
 struct recognizer_test_fixture {
 protected:
 	recognizer_test_fixture()
 	{
-		recognizer = std::make_shared<plate_recognizer>(
-			std::vector<std::shared_ptr<base_plate_finder_strategy>> {
-				std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<plate_finder_by_rectangle>()),
-				std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<plate_finder_by_geometry>())
-			});
+		recognizer = make_recognizer(recognizer_options());
+	}
+
+	//the strategies of every recognizer in the tests, in this order
+	static std::vector<std::shared_ptr<base_plate_finder_strategy>> default_strategies()
+	{
+		return std::vector<std::shared_ptr<base_plate_finder_strategy>> {
+			std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<plate_finder_by_rectangle>()),
+			std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<plate_finder_by_geometry>())
+		};
+	}
+
+	//a recognizer with the default strategies and the given options, and OCR backend (tesseract if there is none)
+	static std::shared_ptr<plate_recognizer> make_recognizer(const recognizer_options& options, const std::shared_ptr<ocr_backend>& ocr = nullptr)
+	{
+		return ocr == nullptr
+			? std::make_shared<plate_recognizer>(default_strategies(), options)
+			: std::make_shared<plate_recognizer>(default_strategies(), ocr, options);
 	}
 	
 	std::shared_ptr<plate_recognizer> recognizer;
@@ -125,6 +159,1385 @@ BOOST_AUTO_TEST_CASE(can_recognize_plate8)
 	}
 }
 
+BOOST_AUTO_TEST_CASE(ocr_engine_pool_creates_engines_on_demand)
+{
+	//nothing but the first engine exists until checkouts overlap
+	ocr_engine_pool default_pool;
+	BOOST_CHECK_EQUAL(default_pool.size(), std::max(1u, std::thread::hardware_concurrency()));
+	BOOST_CHECK_EQUAL(default_pool.created_count(), 1u);
+
+	ocr_engine_pool pool(3);
+	tesseract::TessBaseAPI* first_engine = nullptr;
+	{
+		const auto engine = pool.acquire();
+		first_engine = &*engine;
+	}
+	{
+		//checked back in, so it is handed out again instead of creating another one
+		const auto engine = pool.acquire();
+		BOOST_CHECK(&*engine == first_engine);
+		const auto second_engine = pool.acquire();
+		BOOST_CHECK(&*second_engine != first_engine);
+	}
+	BOOST_CHECK_EQUAL(pool.created_count(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(ocr_engine_pool_never_shares_an_engine)
+{
+	cv::Mat plate(60, 260, CV_8UC1, cv::Scalar(235));
+	cv::putText(plate, "KD482TX", cv::Point(10, 45), cv::FONT_HERSHEY_SIMPLEX, 1.3, cv::Scalar(20), 3, cv::LINE_AA);
+
+	ocr_engine_pool pool(3);
+	std::mutex sync;
+	std::set<tesseract::TessBaseAPI*> engines_in_use;
+	size_t most_in_use = 0;
+	std::atomic<size_t> shared_checkouts(0);
+	std::vector<std::string> texts;
+
+	std::vector<std::thread> threads;
+	for(auto t = 0; t < 8; t++)
+	{
+		threads.emplace_back([&]
+		{
+			for(auto i = 0; i < 4; i++)
+			{
+				const auto engine = pool.acquire();
+				{
+					std::lock_guard<std::mutex> lock(sync);
+					if(!engines_in_use.insert(&*engine).second)
+						shared_checkouts++;
+					most_in_use = std::max(most_in_use, engines_in_use.size());
+				}
+
+				ocr_read read;
+				tesseract_ocr_backend::try_execute_ocr(*engine, plate, read);
+
+				std::lock_guard<std::mutex> lock(sync);
+				engines_in_use.erase(&*engine);
+				texts.push_back(read.text);
+			}
+		});
+	}
+	for(auto& thread : threads)
+		thread.join();
+
+	BOOST_CHECK_EQUAL(shared_checkouts.load(), 0u);
+	BOOST_CHECK(most_in_use <= 3);
+	BOOST_CHECK(pool.created_count() <= 3);
+
+	//engines don't step on each other, so every read of the same image is the same
+	BOOST_REQUIRE_EQUAL(texts.size(), 32u);
+	BOOST_CHECK(std::all_of(texts.begin(), texts.end(), [&](const std::string& text) { return text == texts[0]; }));
+}
+
+BOOST_AUTO_TEST_CASE(can_recognize_plate_with_parallel_strategies)
+{
+	recognizer_options options;
+	options.parallel_strategies = true;
+
+	const auto parallel_recognizer = make_recognizer(options);
+
+	std::multimap<int, std::string, std::greater<int>> sequential_results;
+	BOOST_CHECK_EQUAL(true, recognizer->try_parse("test_license_plate.jpg", sequential_results));
+
+	std::multimap<int, std::string, std::greater<int>> parallel_results;
+	BOOST_CHECK_EQUAL(true, parallel_recognizer->try_parse("test_license_plate.jpg", parallel_results));
+
+	//the merge is deterministic, so running strategies in parallel must not change the outcome
+	BOOST_CHECK(sequential_results == parallel_results);
+	BOOST_CHECK_EQUAL(parallel_results.begin()->second, "FA600CH");
+}
+
+BOOST_AUTO_TEST_CASE(can_recognize_plate_on_downscaled_detection)
+{
+	recognizer_options options;
+	options.expected_plate_height = 48; //detection at half of the resolution
+	options.escalate_detection_scale = false; //so a miss at that scale isn't covered up by a full resolution pass
+
+	const auto downscaled_recognizer = make_recognizer(options);
+
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, downscaled_recognizer->try_parse(cv::imread("test_license_plate.jpg"), results));
+	BOOST_REQUIRE(!results.empty());
+	BOOST_CHECK_EQUAL(results.begin()->second, "FA600CH");
+}
+
+BOOST_AUTO_TEST_CASE(frame_context_scales_strategy_thresholds_with_detection)
+{
+	const cv::Mat image(400, 600, CV_8UC3, cv::Scalar(128, 128, 128));
+	frame_context frame(image);
+
+	//full resolution keeps the sizes the strategies were tuned with
+	BOOST_CHECK_EQUAL(frame.to_detection(8.0), 8.0);
+	BOOST_CHECK_EQUAL(frame.to_detection_kernel(19), 19);
+
+	frame.set_detection_scale(0.25);
+	BOOST_CHECK_EQUAL(frame.to_detection(8.0), 2.0);
+	BOOST_CHECK_EQUAL(frame.to_detection_kernel(19), 5);
+	BOOST_CHECK_EQUAL(frame.to_detection_kernel(5), 3);
+}
+
+BOOST_AUTO_TEST_CASE(cascade_without_early_exit_matches_full_search)
+{
+	recognizer_options options;
+	options.cascade = true;
+	options.cascade_target_confidence = 101; //no read can reach it, so the cascade never stops early
+
+	const auto cascade_recognizer = make_recognizer(options);
+
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, cascade_recognizer->try_parse("test_license_plate.jpg", results));
+	BOOST_CHECK_EQUAL(results.begin()->second, "FA600CH");
+
+	const auto stats = cascade_recognizer->cascade_statistics();
+	BOOST_CHECK_EQUAL(stats.frames, 1);
+	BOOST_CHECK_EQUAL(stats.early_exits, 0);
+	BOOST_CHECK_EQUAL(stats.strategies_skipped, 0);
+	BOOST_CHECK(stats.ocr_calls > 0);
+}
+
+BOOST_AUTO_TEST_CASE(cascade_stops_at_the_first_confident_read)
+{
+	//three candidates in known places, so the cascade has something to skip
+	struct fixed_strategy final : base_plate_finder_strategy
+	{
+		using base_plate_finder_strategy::try_find_and_crop_plate_number;
+
+		bool try_find_and_crop_plate_number(frame_context& frame, std::vector<plate_candidate>& results) override
+		{
+			for(auto i = 0; i < 3; i++)
+			{
+				plate_candidate candidate;
+				candidate.region = cv::Rect(10 + 120 * i, 10, 100, 25);
+				candidate.image = frame.gray()(candidate.region).clone();
+				results.push_back(candidate);
+			}
+			return true;
+		}
+	};
+
+	struct confident_backend final : ocr_backend
+	{
+		std::atomic<size_t> calls { 0 };
+
+		bool try_read(const plate_candidate&, ocr_read& read) override
+		{
+			calls++;
+			read.text = "AB123CD";
+			read.confidence = 95;
+			return read.succeeded = true;
+		}
+
+		size_t concurrency() const override { return 1; }
+	};
+
+	recognizer_options options;
+	options.cascade = true;
+	options.cascade_target_confidence = 90;
+
+	const auto ocr = std::make_shared<confident_backend>();
+	auto strategies = default_strategies();
+	strategies.insert(strategies.begin(), std::make_shared<fixed_strategy>());
+	const auto cascade_recognizer = std::make_shared<plate_recognizer>(strategies, ocr, options);
+
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, cascade_recognizer->try_parse(cv::imread("test_license_plate.jpg"), results));
+	BOOST_CHECK_EQUAL(results.begin()->second, "AB123CD");
+
+	//nothing was measured yet, so the strategies run in the order they were given - the first read of the first one is enough
+	const auto stats = cascade_recognizer->cascade_statistics();
+	BOOST_CHECK_EQUAL(stats.early_exits, 1u);
+	BOOST_CHECK_EQUAL(stats.strategies_skipped, 2u);
+	BOOST_CHECK_EQUAL(stats.candidates_skipped, 2u);
+	BOOST_CHECK_EQUAL(stats.ocr_calls, 1u);
+	BOOST_CHECK_EQUAL(ocr->calls.load(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(cascade_with_early_exit_reads_the_same_plate_as_full_search)
+{
+	std::multimap<int, std::string, std::greater<int>> full_results;
+	BOOST_REQUIRE(recognizer->try_parse("test_license_plate.jpg", full_results));
+
+	//the best read of the full search is reachable by definition, so the cascade has to stop once it gets there
+	recognizer_options options;
+	options.cascade = true;
+	options.cascade_target_confidence = full_results.begin()->first;
+
+	const auto cascade_recognizer = make_recognizer(options);
+
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, cascade_recognizer->try_parse("test_license_plate.jpg", results));
+	BOOST_REQUIRE(!results.empty());
+	BOOST_CHECK_EQUAL(results.begin()->second, full_results.begin()->second);
+	BOOST_CHECK_EQUAL(results.begin()->second, "FA600CH");
+
+	const auto stats = cascade_recognizer->cascade_statistics();
+	BOOST_CHECK_EQUAL(stats.frames, 1u);
+	BOOST_CHECK_EQUAL(stats.early_exits, 1u);
+	BOOST_CHECK(stats.ocr_calls > 0);
+}
+
+BOOST_AUTO_TEST_CASE(metrics_are_collected_only_when_enabled)
+{
+	BOOST_CHECK(recognizer->metrics() == nullptr);
+
+	recognizer_options options;
+	options.enable_metrics = true;
+
+	const auto measured_recognizer = make_recognizer(options);
+
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, measured_recognizer->try_parse("test_license_plate.jpg", results));
+
+	const auto* metrics = measured_recognizer->metrics();
+	BOOST_REQUIRE(metrics != nullptr);
+	BOOST_CHECK_EQUAL(metrics->frame_count(), 1);
+	BOOST_CHECK_EQUAL(metrics->stage_latency(recognizer_stage::decode).count, 1);
+	BOOST_CHECK_EQUAL(metrics->stage_latency(recognizer_stage::total).count, 1);
+	BOOST_CHECK(metrics->ocr_call_count() > 0);
+	BOOST_CHECK(metrics->ocr_hit_count() > 0);
+	BOOST_CHECK(metrics->candidates_of(0) + metrics->candidates_of(1) >= metrics->ocr_call_count());
+
+	const auto ocr = metrics->stage_latency(recognizer_stage::ocr);
+	BOOST_CHECK_EQUAL(ocr.count, metrics->ocr_call_count());
+	BOOST_CHECK(ocr.p50 <= ocr.p99 && ocr.p99 <= ocr.max);
+
+	measured_recognizer->reset_metrics();
+	BOOST_CHECK_EQUAL(metrics->frame_count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(can_recognize_plate_in_nv12_frame)
+{
+	auto bgr = cv::imread("test_license_plate.jpg");
+	bgr = bgr(cv::Rect(0, 0, bgr.cols & ~1, bgr.rows & ~1)).clone(); //4:2:0 needs even dimensions
+
+	cv::Mat i420;
+	cv::cvtColor(bgr, i420, cv::COLOR_BGR2YUV_I420);
+
+	//lay it out like a capture card would - NV12 with padded rows
+	const auto width = bgr.cols, height = bgr.rows;
+	const size_t stride = width + 64;
+	std::vector<unsigned char> nv12(stride * height * 3 / 2);
+	const auto* u_plane = i420.ptr<unsigned char>(height);
+	const auto* v_plane = u_plane + width * height / 4;
+	for(auto y = 0; y < height; y++)
+		std::copy_n(i420.ptr<unsigned char>(y), width, &nv12[y * stride]);
+	for(auto y = 0; y < height / 2; y++)
+		for(auto x = 0; x < width / 2; x++)
+		{
+			nv12[(height + y) * stride + 2 * x] = u_plane[y * width / 2 + x];
+			nv12[(height + y) * stride + 2 * x + 1] = v_plane[y * width / 2 + x];
+		}
+
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, recognizer->try_parse(raw_frame(nv12.data(), width, height, pixel_format::nv12, stride), results));
+
+	const auto found = std::any_of(results.begin(), results.end(),
+		[](const std::pair<const int, std::string>& read) { return read.second == "FA600CH"; });
+	BOOST_CHECK(found);
+}
+
+BOOST_AUTO_TEST_CASE(should_throw_if_raw_frame_invalid)
+{
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_THROW(recognizer->try_parse(raw_frame(nullptr, 640, 480, pixel_format::nv12), results), std::invalid_argument);
+
+	std::vector<unsigned char> pixels(640 * 480 * 3);
+	BOOST_CHECK_THROW(recognizer->try_parse(raw_frame(pixels.data(), 640, 480, pixel_format::bgr, 640), results), std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(can_recognize_plate_from_encoded_buffer)
+{
+	std::ifstream file("test_license_plate.jpg", std::ios::binary);
+	const std::vector<unsigned char> encoded((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, recognizer->try_parse_encoded(encoded.data(), encoded.size(), results));
+	BOOST_CHECK_EQUAL(results.begin()->second, "FA600CH");
+
+	std::multimap<int, std::string, std::greater<int>> no_results;
+	BOOST_CHECK_THROW(recognizer->try_parse_encoded(encoded.data(), 0, no_results), std::exception);
+}
+
+BOOST_AUTO_TEST_CASE(path_overload_respects_confidence_threshold)
+{
+	recognizer_options options;
+	options.expected_plate_height = 96; //detection on a reduced decode (a quarter of the resolution)
+
+	const auto reduced_recognizer = make_recognizer(options);
+
+	//the reduced decode does find the plate with the default threshold...
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, reduced_recognizer->try_parse("test_license_plate.jpg", results));
+	const auto found = std::any_of(results.begin(), results.end(),
+		[](const std::pair<const int, std::string>& read) { return read.second == "FA600CH"; });
+	BOOST_CHECK(found);
+
+	//...so an empty result above 100 is the threshold at work (no read can be more confident than 100)
+	std::multimap<int, std::string, std::greater<int>> thresholded_results;
+	BOOST_CHECK_EQUAL(false, reduced_recognizer->try_parse("test_license_plate.jpg", thresholded_results, 101));
+	BOOST_CHECK(thresholded_results.empty());
+}
+
+BOOST_AUTO_TEST_CASE(strategies_decode_the_full_frame_only_to_crop_a_candidate)
+{
+	size_t decodes = 0;
+	frame_context frame;
+	std::vector<plate_candidate> results;
+
+	//nothing to find on the reduced grayscale, so nothing must ever ask for the full resolution
+	frame.reset(cv::Mat(120, 160, CV_8UC1, cv::Scalar(128)), 0.25, [&decodes]
+	{
+		decodes++;
+		return cv::Mat(480, 640, CV_8UC3, cv::Scalar(128, 128, 128));
+	});
+	frame.set_detection_scale(0.25);
+
+	plate_finder_by_rectangle rectangle;
+	plate_finder_by_geometry geometry;
+	BOOST_CHECK(!rectangle.try_find_and_crop_plate_number(frame, results));
+	BOOST_CHECK(!geometry.try_find_and_crop_plate_number(frame, results));
+	BOOST_CHECK(results.empty());
+	BOOST_CHECK_EQUAL(decodes, 0u);
+
+	//a frame with a plate is decoded once, when the first candidate is cropped
+	const auto path = "test_license_plate.jpg";
+	frame.reset(cv::imread(path, cv::IMREAD_REDUCED_GRAYSCALE_4), 0.25, [&decodes, path]
+	{
+		decodes++;
+		return cv::imread(path);
+	});
+	frame.set_detection_scale(0.25);
+
+	rectangle.try_find_and_crop_plate_number(frame, results);
+	geometry.try_find_and_crop_plate_number(frame, results);
+	BOOST_REQUIRE(!results.empty());
+	BOOST_CHECK_EQUAL(decodes, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(can_recognize_plates_in_batch)
+{
+	const std::vector<std::string> image_paths { "test_license_plate.jpg", "test_license_plate_invalid.jpg", "test_license_plate3.jpg" };
+
+	std::vector<std::multimap<int, std::string, std::greater<int>>> results;
+	batch_stats stats;
+	BOOST_CHECK_EQUAL(true, recognizer->try_parse_batch(image_paths, results, stats));
+
+	BOOST_REQUIRE_EQUAL(results.size(), image_paths.size());
+	BOOST_REQUIRE(!results[0].empty());
+	BOOST_CHECK_EQUAL(results[0].begin()->second, "FA600CH");
+	BOOST_CHECK(results[1].empty());
+	BOOST_REQUIRE(!results[2].empty());
+	BOOST_CHECK_EQUAL(results[2].begin()->second, "EW841CH");
+
+	BOOST_CHECK_EQUAL(stats.failed_images, 1);
+	BOOST_CHECK_EQUAL(stats.decode.processed_items, 3);
+	BOOST_CHECK_EQUAL(stats.detect.processed_items, 2);
+	BOOST_CHECK(stats.ocr.processed_items > 0);
+}
+
+BOOST_AUTO_TEST_CASE(stream_recognizer_reuses_reads_of_tracked_plates)
+{
+	stream_options options;
+	options.stable_confidence = 0; //any successful read is good enough to be reused
+
+	plate_stream_recognizer stream(recognizer, options);
+	const auto frame = cv::imread("test_license_plate.jpg");
+
+	std::multimap<int, std::string, std::greater<int>> first_frame_results;
+	BOOST_CHECK_EQUAL(true, stream.try_parse_frame(frame, first_frame_results));
+	BOOST_REQUIRE(!first_frame_results.empty());
+	BOOST_CHECK_EQUAL(first_frame_results.begin()->second, "FA600CH");
+
+	const auto ocr_calls_after_first_frame = stream.statistics().ocr_calls;
+
+	std::multimap<int, std::string, std::greater<int>> second_frame_results;
+	BOOST_CHECK_EQUAL(true, stream.try_parse_frame(frame, second_frame_results));
+	BOOST_CHECK(first_frame_results == second_frame_results);
+
+	//the plate didn't move, so the read plates must not be OCR-ed again
+	BOOST_CHECK(stream.statistics().reused_reads > 0);
+	BOOST_CHECK(stream.statistics().ocr_calls - ocr_calls_after_first_frame < ocr_calls_after_first_frame);
+}
+
+BOOST_AUTO_TEST_CASE(stream_recognizer_backs_off_on_unreadable_plates)
+{
+	//a plate that is found on every frame but never read
+	struct unreadable_backend final : ocr_backend
+	{
+		bool try_read(const plate_candidate&, ocr_read& read) override { return read.succeeded = false; }
+		size_t concurrency() const override { return 1; }
+	};
+
+	const auto unreadable_recognizer = make_recognizer(recognizer_options(), std::make_shared<unreadable_backend>());
+
+	plate_stream_recognizer stream(unreadable_recognizer);
+	const auto frame = cv::imread("test_license_plate.jpg");
+
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(false, stream.try_parse_frame(frame, results));
+	const auto tracks = stream.statistics().ocr_calls;
+	BOOST_REQUIRE(tracks > 0);
+
+	for(auto i = 1; i < 16; i++)
+		BOOST_CHECK_EQUAL(false, stream.try_parse_frame(frame, results));
+
+	//OCR-ed on frames 1, 3, 7 and 15 - not on every one of the 16
+	BOOST_CHECK_EQUAL(stream.statistics().ocr_calls, 4 * tracks);
+	BOOST_CHECK_EQUAL(stream.statistics().deferred_reads, 12 * tracks);
+	BOOST_CHECK_EQUAL(stream.statistics().reused_reads, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(stream_recognizer_keeps_plates_outside_of_the_changed_regions)
+{
+	//every bright blob is a plate, in the coordinates of the frame (or the region of it) the strategy is given
+	struct bright_blob_strategy final : base_plate_finder_strategy
+	{
+		using base_plate_finder_strategy::try_find_and_crop_plate_number;
+
+		bool try_find_and_crop_plate_number(frame_context& frame, std::vector<plate_candidate>& results) override
+		{
+			cv::Mat bright;
+			cv::threshold(frame.gray(), bright, 200, 255, cv::THRESH_BINARY);
+
+			std::vector<std::vector<cv::Point>> contours;
+			cv::findContours(bright, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+			for(const auto& contour : contours)
+			{
+				plate_candidate candidate;
+				candidate.region = cv::boundingRect(contour);
+				candidate.image = frame.gray()(candidate.region).clone();
+				results.push_back(candidate);
+			}
+			return !contours.empty();
+		}
+	};
+
+	struct confident_backend final : ocr_backend
+	{
+		bool try_read(const plate_candidate&, ocr_read& read) override
+		{
+			read.text = "AB123CD";
+			read.confidence = 95;
+			return read.succeeded = true;
+		}
+
+		size_t concurrency() const override { return 1; }
+	};
+
+	const auto blob_recognizer = std::make_shared<plate_recognizer>(
+		std::vector<std::shared_ptr<base_plate_finder_strategy>> {
+			std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<bright_blob_strategy>())
+		}, std::make_shared<confident_backend>());
+
+	stream_options options;
+	options.motion_gating = true;
+	options.motion.regions_of_interest = { { { 0, 240 }, { 640, 240 }, { 640, 480 }, { 0, 480 } } };
+	plate_stream_recognizer stream(blob_recognizer, options);
+
+	const cv::Mat road(480, 640, CV_8UC3, cv::Scalar(90, 90, 90));
+	const cv::Rect parked(100, 300, 120, 30);
+	auto with_parked = road.clone();
+	cv::rectangle(with_parked, parked, cv::Scalar(250, 250, 250), cv::FILLED);
+
+	//the first frame is searched whole (within the ROI), the parked plate gets its track
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, stream.try_parse_frame(with_parked, results));
+	BOOST_REQUIRE_EQUAL(stream.active_tracks().size(), 1u);
+	BOOST_CHECK(stream.active_tracks()[0].region == parked);
+	const auto parked_id = stream.active_tracks()[0].id;
+
+	//nothing moved
+	results.clear();
+	BOOST_CHECK_EQUAL(false, stream.try_parse_frame(with_parked, results));
+	BOOST_CHECK_EQUAL(stream.statistics().gated_frames, 1u);
+
+	//a vehicle passes on the other side of the lane for longer than a track may be missed,
+	//only the region around it is searched - the parked plate is not there, but it didn't go anywhere either
+	cv::Rect passing(400, 380, 120, 30);
+	for(size_t i = 0; i < options.max_missed_frames + 3; i++, passing.x -= 10)
+	{
+		auto frame = with_parked.clone();
+		cv::rectangle(frame, passing, cv::Scalar(250, 250, 250), cv::FILLED);
+
+		results.clear();
+		BOOST_CHECK_EQUAL(true, stream.try_parse_frame(frame, results));
+	}
+	passing.x += 10;
+
+	BOOST_CHECK_EQUAL(stream.statistics().gated_frames, 1u);
+	BOOST_CHECK_EQUAL(stream.statistics().tracks_created, 2u);
+	BOOST_REQUIRE_EQUAL(stream.active_tracks().size(), 2u);
+	for(const auto& track : stream.active_tracks())
+	{
+		//candidates found in a changed region are reported in the coordinates of the whole frame
+		BOOST_CHECK(track.region == (track.id == parked_id ? parked : passing));
+		BOOST_CHECK_EQUAL(track.missed_frames, 0u);
+	}
+
+	//once the parked car leaves, its region changes and the track ages out as usual
+	for(size_t i = 0; i <= options.max_missed_frames; i++)
+		stream.try_parse_frame(road, results);
+
+	for(const auto& track : stream.active_tracks())
+		BOOST_CHECK(track.id != parked_id);
+}
+
+BOOST_AUTO_TEST_CASE(frame_context_never_writes_into_a_grayscale_input)
+{
+	const auto color = cv::imread("test_license_plate.jpg");
+	const auto gray_input = cv::imread("test_license_plate.jpg", cv::IMREAD_GRAYSCALE);
+	const auto gray_copy = gray_input.clone();
+
+	//the grayscale of a 1-channel frame is the caller's image, the next frame must not be converted into it
+	frame_context frame(gray_input);
+	BOOST_CHECK(frame.gray().data == gray_input.data);
+	frame.reset(color);
+	BOOST_CHECK(frame.gray().data != gray_input.data);
+	BOOST_CHECK_EQUAL(cv::countNonZero(gray_input != gray_copy), 0);
+
+	//same through the frame context the recognizer keeps for this thread
+	std::multimap<int, std::string, std::greater<int>> results;
+	recognizer->try_parse(gray_input, results);
+	recognizer->try_parse(color, results);
+	BOOST_CHECK_EQUAL(cv::countNonZero(gray_input != gray_copy), 0);
+}
+
+BOOST_AUTO_TEST_CASE(frame_context_maps_detection_coordinates_to_source)
+{
+	const cv::Mat image(400, 600, CV_8UC3, cv::Scalar(128, 128, 128));
+	frame_context frame(image);
+
+	frame.set_detection_scale(0.25);
+	BOOST_CHECK_EQUAL(frame.detection_gray().rows, 100);
+	BOOST_CHECK_EQUAL(frame.detection_gray().cols, 150);
+	BOOST_CHECK_EQUAL(frame.gray().cols, 600); //full resolution grayscale is still there for cropping
+
+	std::vector<cv::Point> corners { cv::Point(10, 20), cv::Point(149, 99) };
+	frame.to_source(corners);
+	BOOST_CHECK(corners[0] == cv::Point(40, 80));
+	BOOST_CHECK(corners[1] == cv::Point(596, 396));
+
+	//a new frame starts at full resolution again
+	frame.reset(image);
+	BOOST_CHECK_EQUAL(frame.detection_scale(), 1.0);
+	BOOST_CHECK_EQUAL(frame.detection_gray().cols, 600);
+}
+
+BOOST_AUTO_TEST_CASE(overlapping_candidates_are_collapsed_only_within_a_strategy)
+{
+	const auto candidate_of = [](const cv::Rect& region, const size_t strategy_index)
+	{
+		plate_candidate candidate;
+		candidate.region = region;
+		candidate.strategy_index = strategy_index;
+		return candidate;
+	};
+
+	std::vector<plate_candidate> candidates {
+		candidate_of(cv::Rect(100, 100, 200, 50), 0),
+		candidate_of(cv::Rect(102, 101, 196, 48), 0), //the same plate found twice by the same strategy
+		candidate_of(cv::Rect(101, 100, 198, 50), 1), //...and by another one, its crop may be the one that reads
+		candidate_of(cv::Rect(400, 100, 200, 50), 0)
+	};
+	candidate_consolidation::suppress_overlapping(candidates, 0.8);
+
+	BOOST_REQUIRE_EQUAL(candidates.size(), 3u);
+	BOOST_CHECK(candidates[0].region == cv::Rect(100, 100, 200, 50));
+	BOOST_CHECK_EQUAL(candidates[1].strategy_index, 1u);
+	BOOST_CHECK(candidates[2].region == cv::Rect(400, 100, 200, 50));
+}
+
+BOOST_AUTO_TEST_CASE(contour_arena_holds_the_same_contours_as_find_contours)
+{
+	cv::Mat image = cv::Mat::zeros(200, 300, CV_8U);
+	cv::rectangle(image, cv::Rect(10, 10, 50, 30), cv::Scalar(255), cv::FILLED);
+	cv::circle(image, cv::Point(150, 100), 40, cv::Scalar(255), 3);
+	cv::putText(image, "AB12", cv::Point(20, 180), cv::FONT_HERSHEY_SIMPLEX, 1.5, cv::Scalar(255), 3);
+
+	std::vector<std::vector<cv::Point>> expected;
+	cv::findContours(image, expected, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+
+	//filled twice, the second time over the memory of the first
+	contour_arena contours;
+	for(auto pass = 0; pass < 2; pass++)
+	{
+		contours.find_contours(image, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+
+		BOOST_REQUIRE_EQUAL(contours.size(), expected.size());
+		for(size_t i = 0; i < expected.size(); i++)
+			BOOST_CHECK(contours[i] == contour_view(expected[i]));
+	}
+
+	contours.clear();
+	BOOST_CHECK(contours.empty());
+	BOOST_CHECK_EQUAL(contours.point_count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(char_grid_finds_all_neighbours_within_radius)
+{
+	std::mt19937 random(42);
+	std::uniform_int_distribution<int> position(0, 1920);
+	std::uniform_int_distribution<int> size(3, 40);
+
+	contour_arena contours;
+	for(int i = 0; i < 2000; i++)
+	{
+		const cv::Rect rect(position(random), position(random), size(random), size(random));
+		contours.add(std::vector<cv::Point> { rect.tl(), cv::Point(rect.x + rect.width, rect.y), rect.br(), cv::Point(rect.x, rect.y + rect.height) });
+	}
+
+	std::vector<if_char> chars;
+	for(size_t i = 0; i < contours.size(); i++)
+		chars.emplace_back(contours[i]);
+
+	char_grid grid;
+	grid.build(chars, 60.0);
+
+	std::vector<size_t> neighbours;
+	for(size_t i = 0; i < chars.size(); i++)
+	{
+		const auto radius = chars[i].diagonal_size() * 5;
+		grid.query(chars[i].center_x(), chars[i].center_y(), radius, neighbours);
+
+		BOOST_REQUIRE(std::is_sorted(neighbours.begin(), neighbours.end()));
+
+		//brute force - every char within the radius must be returned by the grid
+		for(size_t j = 0; j < chars.size(); j++)
+		{
+			if(chars[i].distance_to(chars[j]) < radius)
+				BOOST_REQUIRE(std::binary_search(neighbours.begin(), neighbours.end(), j));
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(rectangle_crop_is_clipped_to_the_frame)
+{
+	//corners mapped back from a detection scale that isn't a power of two, rounded one pixel past the right and bottom border
+	const cv::Mat image(50, 100, CV_8UC3, cv::Scalar(200, 200, 200));
+	const std::vector<cv::Point> corners { { 10, 5 }, { 100, 5 }, { 100, 50 }, { 10, 50 } };
+
+	plate_finder_by_rectangle finder;
+	cv::Mat cropped, mask;
+	BOOST_CHECK_NO_THROW(finder.crop_plate_candidate(image, cv::Mat(corners), cropped, mask));
+	BOOST_CHECK(cropped.size() == cv::Size(90, 45));
+	BOOST_CHECK(cropped.at<cv::Vec3b>(44, 89) == cv::Vec3b(200, 200, 200));
+
+	//entirely outside there is nothing to crop
+	const std::vector<cv::Point> outside { { 100, 50 }, { 120, 50 }, { 120, 60 }, { 100, 60 } };
+	finder.crop_plate_candidate(image, cv::Mat(outside), cropped, mask);
+	BOOST_CHECK(cropped.empty());
+}
+
+BOOST_AUTO_TEST_CASE(geometry_crop_matches_rotating_the_whole_frame)
+{
+	//six characters on a line tilted by 8 degrees, blurred a little so both ways of sampling see smooth edges
+	cv::Mat image(360, 640, CV_8UC1, cv::Scalar(30));
+	const auto slope = std::tan(8.0 * M_PI / 180.0);
+	std::vector<if_char> chars(6);
+	std::vector<size_t> sequence;
+	for(size_t i = 0; i < chars.size(); i++)
+	{
+		chars[i].bounding_rect = cv::Rect(120 + 30 * static_cast<int>(i), 150 + static_cast<int>(std::lround(30 * i * slope)), 14, 26);
+		cv::rectangle(image, chars[i].bounding_rect, cv::Scalar(240), cv::FILLED);
+		sequence.push_back(i);
+	}
+	cv::GaussianBlur(image, image, cv::Size(3, 3), 0);
+
+	const possible_plate plate(chars, sequence);
+	BOOST_REQUIRE(plate.angle > 7 && plate.angle < 9);
+
+	//the old way: rotate the whole frame around the plate and cut the plate out of it
+	//(its output size had rows and cols swapped, the plate is placed where that didn't cut anything off)
+	BOOST_REQUIRE(plate.bounding_rect().br().x < image.rows);
+	cv::Mat rotated, expected;
+	cv::warpAffine(image, rotated, cv::getRotationMatrix2D(plate.center, plate.angle, 1.0), cv::Size(image.rows, image.cols));
+	cv::getRectSubPix(rotated, cv::Size(plate.width, plate.height), plate.center, expected);
+
+	cv::Mat cropped;
+	plate_finder_by_geometry::crop_plate_candidate(image, plate, cropped);
+	BOOST_REQUIRE_EQUAL(cropped.size(), expected.size());
+	BOOST_REQUIRE_EQUAL(cropped.type(), expected.type());
+
+	//the old way interpolated twice, so the pixels aren't bit exact - but they are the same picture
+	cv::Mat difference;
+	cv::absdiff(cropped, expected, difference);
+	BOOST_CHECK(cv::mean(difference)[0] < 3.0);
+
+	//the characters mapped into the crop land on the glyphs, and the gaps between them stay dark
+	std::vector<cv::Rect> boxes;
+	plate_finder_by_geometry::map_characters_to_crop(chars, sequence, 1.0, plate, boxes);
+	BOOST_REQUIRE_EQUAL(boxes.size(), chars.size());
+	for(size_t i = 0; i < boxes.size(); i++)
+	{
+		BOOST_CHECK(cv::mean(cropped(boxes[i]))[0] > 150);
+
+		const cv::Point center(boxes[i].x + boxes[i].width / 2, boxes[i].y + boxes[i].height / 2);
+		BOOST_CHECK(cropped.at<uchar>(center) > 200);
+
+		if(i + 1 < boxes.size())
+		{
+			const cv::Point next(boxes[i + 1].x + boxes[i + 1].width / 2, boxes[i + 1].y + boxes[i + 1].height / 2);
+			BOOST_CHECK(cropped.at<uchar>((center + next) / 2) < 100);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(normalized_candidates_are_grayscale_dark_on_light)
+{
+	//light text on a dark plate, twice the normalized height
+	cv::Mat plate(96, 300, CV_8UC3, cv::Scalar(40, 30, 30));
+	cv::putText(plate, "AB12", cv::Point(20, 70), cv::FONT_HERSHEY_SIMPLEX, 2.0, cv::Scalar(250, 250, 250), 4);
+
+	plate_candidate candidate;
+	candidate.characters.push_back(cv::Rect(20, 20, 40, 50));
+
+	cv::Mat gray, resized;
+	candidate_normalization::normalize(plate, pixel_format::bgr, gray, resized, candidate);
+
+	const auto padding = candidate_normalization::padding;
+	BOOST_CHECK_EQUAL(candidate.image.type(), CV_8UC1);
+	BOOST_CHECK_EQUAL(candidate.image.rows, candidate_normalization::plate_height + 2 * padding);
+	BOOST_CHECK_EQUAL(candidate.image.cols, 150 + 2 * padding);
+
+	//still grayscale (OCR gets the edges, not a thresholded image), inverted to a light background and dark text
+	BOOST_CHECK_LT(cv::countNonZero(candidate.image == 0) + cv::countNonZero(candidate.image == 255), candidate.image.rows * candidate.image.cols);
+	BOOST_CHECK_GT(cv::countNonZero(candidate.image > 128), candidate.image.rows * candidate.image.cols / 2);
+	double darkest = 0;
+	cv::minMaxLoc(candidate.image, &darkest);
+	BOOST_CHECK_LT(darkest, 64);
+
+	//the character box is scaled down by half and shifted by the padding
+	BOOST_CHECK(candidate.characters[0] == cv::Rect(10 + padding, 10 + padding, 20, 25));
+}
+
+BOOST_AUTO_TEST_CASE(char_classifier_reads_printed_plate)
+{
+	//dark text on a light plate, in a font the built-in model has never seen (it is rendered from SIMPLEX, DUPLEX, COMPLEX and TRIPLEX)
+	const std::string number = "KD482TX";
+	int baseline = 0;
+	const auto text_size = cv::getTextSize(number, cv::FONT_HERSHEY_PLAIN, 3.0, 3, &baseline);
+	cv::Mat plate(text_size.height + baseline + 30, text_size.width + 30, CV_8UC3, cv::Scalar(235, 235, 235));
+	cv::putText(plate, number, cv::Point(15, text_size.height + 15), cv::FONT_HERSHEY_PLAIN, 3.0, cv::Scalar(20, 20, 20), 3, cv::LINE_AA);
+
+	plate_candidate candidate;
+	cv::Mat gray, resized;
+	candidate_normalization::normalize(plate, pixel_format::bgr, gray, resized, candidate);
+
+	char_classifier_backend backend(nullptr);
+	ocr_read read;
+	BOOST_CHECK(backend.try_read(candidate, read));
+	BOOST_CHECK_EQUAL(read.text, "KD482TX");
+	BOOST_CHECK_EQUAL(read.char_confidences.size(), read.text.size());
+	BOOST_CHECK_EQUAL(backend.classified_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(char_classifier_falls_back_when_unsure)
+{
+	struct fixed_backend final : ocr_backend
+	{
+		size_t calls = 0;
+
+		bool try_read(const plate_candidate&, ocr_read& read) override
+		{
+			calls++;
+			read.text = "FALLBACK";
+			read.confidence = 77;
+			return read.succeeded = true;
+		}
+
+		size_t concurrency() const override { return 1; }
+	};
+
+	const auto fallback = std::make_shared<fixed_backend>();
+	char_classifier_backend backend(fallback);
+
+	//nothing that looks like characters
+	plate_candidate candidate;
+	candidate.image = cv::Mat(60, 260, CV_8UC4, cv::Scalar(200, 200, 200, 255));
+
+	ocr_read read;
+	BOOST_CHECK(backend.try_read(candidate, read));
+	BOOST_CHECK_EQUAL(read.text, "FALLBACK");
+	BOOST_CHECK_EQUAL(fallback->calls, 1);
+	BOOST_CHECK_EQUAL(backend.fallback_count(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(char_classifier_falls_back_when_some_characters_are_unsure)
+{
+	struct fixed_backend final : ocr_backend
+	{
+		size_t calls = 0;
+		const cv::Mat* last_image = nullptr;
+
+		bool try_read(const plate_candidate& candidate, ocr_read& read) override
+		{
+			calls++;
+			last_image = &candidate.image;
+			read.text = "FALLBACK";
+			read.confidence = 77;
+			return read.succeeded = true;
+		}
+
+		size_t concurrency() const override { return 1; }
+	};
+
+	cv::Mat plate(60, 260, CV_8UC3, cv::Scalar(235, 235, 235));
+	cv::putText(plate, "KD482TX", cv::Point(10, 45), cv::FONT_HERSHEY_SIMPLEX, 1.3, cv::Scalar(20, 20, 20), 3, cv::LINE_AA);
+
+	plate_candidate candidate;
+	cv::Mat gray, resized;
+	candidate_normalization::normalize(plate, pixel_format::bgr, gray, resized, candidate);
+
+	//how sure the classifier is of each character
+	ocr_read classified;
+	char_classifier_backend(nullptr, 0).try_classify(candidate, classified);
+	BOOST_REQUIRE(classified.char_confidences.size() > 3);
+	const auto least_confident = *std::min_element(classified.char_confidences.begin(), classified.char_confidences.end());
+	const auto most_confident = *std::max_element(classified.char_confidences.begin(), classified.char_confidences.end());
+	BOOST_REQUIRE(least_confident < most_confident);
+
+	//with the bar between them, some of the characters pass and some don't - which is enough to hand the plate over
+	const auto fallback = std::make_shared<fixed_backend>();
+	char_classifier_backend backend(fallback, most_confident);
+
+	ocr_read read;
+	BOOST_CHECK(backend.try_read(candidate, read));
+	BOOST_CHECK_EQUAL(read.text, "FALLBACK");
+	BOOST_CHECK_EQUAL(read.confidence, 77);
+	BOOST_CHECK(read.char_confidences.empty()); //nothing of the classifier's attempt is left in the read
+	BOOST_CHECK_EQUAL(fallback->calls, 1);
+	BOOST_CHECK(fallback->last_image == &candidate.image);
+	BOOST_CHECK_EQUAL(backend.fallback_count(), 1);
+	BOOST_CHECK_EQUAL(backend.classified_count(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(contrast_kernel_is_bit_exact_with_opencv_chain)
+{
+	std::mt19937 random(42);
+	std::uniform_int_distribution<int> pixel(0, 255);
+	const auto kernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(3, 3));
+
+	//odd sizes exercise the scalar tails and the borders, the ROI has rows that are not tightly packed
+	const std::vector<cv::Size> sizes { { 1, 1 }, { 2, 3 }, { 17, 5 }, { 31, 2 }, { 33, 33 }, { 65, 7 }, { 640, 480 } };
+	for(const auto& size : sizes)
+	{
+		cv::Mat padded(size.height + 2, size.width + 5, CV_8UC1);
+		for(auto y = 0; y < padded.rows; y++)
+			for(auto x = 0; x < padded.cols; x++)
+				padded.at<uchar>(y, x) = static_cast<uchar>(pixel(random) < 64 ? (pixel(random) & 1) * 255 : pixel(random));
+		const auto gray = padded(cv::Rect(2, 1, size.width, size.height));
+
+		cv::Mat top_hat, black_hat, sum, expected;
+		cv::morphologyEx(gray, top_hat, cv::MORPH_TOPHAT, kernel);
+		cv::morphologyEx(gray, black_hat, cv::MORPH_BLACKHAT, kernel);
+		cv::add(gray, top_hat, sum);
+		cv::subtract(sum, black_hat, expected);
+
+		cv::Mat result, scratch;
+		contrast_kernel::apply(gray, result, scratch);
+		BOOST_CHECK_EQUAL(cv::countNonZero(result != expected), 0);
+
+		std::vector<uint8_t> scalar_result(static_cast<size_t>(size.area()));
+		std::vector<uint8_t> scalar_scratch(contrast_kernel::scratch_size(size.width));
+		contrast_kernel::apply_scalar(gray.data, gray.step, scalar_result.data(), size.width, size.width, size.height, scalar_scratch.data());
+		BOOST_CHECK_EQUAL(cv::countNonZero(cv::Mat(size, CV_8UC1, scalar_result.data()) != expected), 0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(motion_gate_passes_only_changes_inside_the_roi)
+{
+	motion_gate_options options;
+	options.regions_of_interest = { { { 0, 240 }, { 640, 240 }, { 640, 480 }, { 0, 480 } } };
+	motion_gate gate(options);
+
+	const cv::Mat road(480, 640, CV_8UC3, cv::Scalar(90, 90, 90));
+	std::vector<cv::Rect> changed;
+
+	//the first frame has nothing to compare to, so all of the ROI counts as changed
+	BOOST_CHECK(gate.update(road, changed));
+	BOOST_REQUIRE_EQUAL(changed.size(), 1u);
+	BOOST_CHECK(changed[0] == cv::Rect(0, 240, 640, 240));
+
+	BOOST_CHECK(!gate.update(road, changed));
+	BOOST_CHECK(changed.empty());
+
+	//a change above the lane is ignored
+	auto frame = road.clone();
+	cv::rectangle(frame, cv::Rect(300, 40, 120, 80), cv::Scalar(250, 250, 250), cv::FILLED);
+	BOOST_CHECK(!gate.update(frame, changed));
+
+	//a vehicle in the lane is passed on, with the region around it
+	frame = road.clone();
+	const cv::Rect vehicle(200, 300, 160, 100);
+	cv::rectangle(frame, vehicle, cv::Scalar(250, 250, 250), cv::FILLED);
+	BOOST_CHECK(gate.update(frame, changed));
+	BOOST_REQUIRE_EQUAL(changed.size(), 1u);
+	BOOST_CHECK((changed[0] & vehicle) == vehicle);
+	BOOST_CHECK(changed[0].area() < 640 * 240);
+
+	BOOST_CHECK_EQUAL(gate.statistics().frames, 4u);
+	BOOST_CHECK_EQUAL(gate.statistics().static_frames, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(persister_writes_reads_in_order_and_in_batches)
+{
+	auto sink = std::make_shared<in_memory_plate_sink>();
+	sink->fail_next_writes(1);
+
+	persister_options options;
+	options.max_batch_size = 100;
+	options.max_batch_delay = std::chrono::milliseconds(20);
+	options.retry_delay = std::chrono::milliseconds(1);
+	async_plate_persister persister(sink, options);
+
+	for(auto i = 0; i < 1000; i++)
+		BOOST_CHECK(persister.enqueue(plate { std::to_string(i), static_cast<std::time_t>(i) }));
+	persister.flush();
+
+	const auto plates = sink->plates();
+	BOOST_REQUIRE_EQUAL(plates.size(), 1000u);
+	for(auto i = 0; i < 1000; i++)
+		BOOST_CHECK_EQUAL(plates[i].number, std::to_string(i));
+
+	for(const auto& batch : sink->batches())
+		BOOST_CHECK(batch.size() <= 100);
+
+	//the failed write was retried, nothing got lost
+	const auto stats = persister.statistics();
+	BOOST_CHECK_EQUAL(stats.written, 1000u);
+	BOOST_CHECK_EQUAL(stats.failed, 0u);
+	BOOST_CHECK_EQUAL(stats.failed_attempts, 1u);
+	BOOST_CHECK(stats.batches >= 10);
+}
+
+//a sink that doesn't return until it is told to, like a database that stopped answering
+struct stalled_plate_sink final : plate_sink
+{
+	std::promise<void> release;
+	std::shared_future<void> released = release.get_future().share();
+
+	void write_batch(const std::vector<plate>&) override
+	{
+		released.wait();
+	}
+};
+
+BOOST_AUTO_TEST_CASE(persister_drops_reads_instead_of_blocking_when_full)
+{
+	auto sink = std::make_shared<stalled_plate_sink>();
+
+	persister_options options;
+	options.queue_capacity = 4;
+	options.max_batch_size = 1;
+	async_plate_persister persister(sink, options);
+
+	size_t accepted = 0;
+	for(auto i = 0; i < 10; i++)
+		accepted += persister.try_enqueue(plate { std::to_string(i), 0 }) ? 1 : 0;
+
+	//the writer holds at most one read, the rest has to fit into the queue
+	auto stats = persister.statistics();
+	BOOST_CHECK(accepted <= 5);
+	BOOST_CHECK_EQUAL(stats.enqueued, accepted);
+	BOOST_CHECK_EQUAL(stats.dropped, 10 - accepted);
+	BOOST_CHECK_EQUAL(stats.queue_high_water_mark, 4u);
+
+	sink->release.set_value();
+	persister.flush();
+	stats = persister.statistics();
+	BOOST_CHECK_EQUAL(stats.written, accepted);
+	BOOST_CHECK_EQUAL(stats.queue_depth, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(journal_replays_records_across_segments_and_sets_damaged_ones_aside)
+{
+	const auto directory = (std::filesystem::temp_directory_path() / "raven_anpr_journal_test").string();
+	std::filesystem::remove_all(directory);
+
+	//small segments, so the records are spread over a few of them
+	journal_options options;
+	options.segment_size = 4096;
+
+	plate_journal journal(directory, options);
+	for(auto i = 0; i < 1000; i++)
+		journal.append(plate { "AB" + std::to_string(i), static_cast<std::time_t>(i), static_cast<std::time_t>(i + 5), i % 100, static_cast<size_t>(i % 7 + 1) });
+	journal.rotate();
+
+	in_memory_plate_sink sink;
+	const plate_journal_replayer replayer(directory, 100);
+	const auto stats = replayer.replay(sink, journal.active_sequence());
+
+	const auto plates = sink.plates();
+	BOOST_REQUIRE_EQUAL(plates.size(), 1000u);
+	for(auto i = 0; i < 1000; i++)
+	{
+		BOOST_CHECK_EQUAL(plates[i].number, "AB" + std::to_string(i));
+		BOOST_CHECK_EQUAL(plates[i].when_taken, static_cast<std::time_t>(i));
+		BOOST_CHECK_EQUAL(plates[i].last_seen, static_cast<std::time_t>(i + 5));
+		BOOST_CHECK_EQUAL(plates[i].confidence, i % 100);
+		BOOST_CHECK_EQUAL(plates[i].reads, static_cast<size_t>(i % 7 + 1));
+	}
+	BOOST_CHECK(stats.completed);
+	BOOST_CHECK(stats.segments > 1);
+	BOOST_CHECK_EQUAL(stats.corrupted_segments, 0u);
+
+	//only the active segment is left
+	BOOST_CHECK_EQUAL(plate_journal::list_segments(directory).size(), 1u);
+
+	//a damaged record ends its segment, the records before it still make it and the segment is kept aside
+	for(auto i = 0; i < 10; i++)
+		journal.append(plate { "CD" + std::to_string(i), 0 });
+	journal.rotate();
+
+	const auto damaged = (std::filesystem::path(directory) / plate_journal::segment_file_name(journal.active_sequence() - 1)).string();
+	{
+		std::fstream file(damaged, std::ios::in | std::ios::out | std::ios::binary);
+		//the 6th record: past the segment header and five records of 8 + 26 + 3 bytes, into its characters
+		file.seekp(16 + 5 * 37 + 34);
+		file.put('#');
+	}
+
+	in_memory_plate_sink second_sink;
+	const auto second_stats = replayer.replay(second_sink, journal.active_sequence());
+	BOOST_REQUIRE_EQUAL(second_sink.plates().size(), 5u);
+	for(auto i = 0; i < 5; i++)
+		BOOST_CHECK_EQUAL(second_sink.plates()[i].number, "CD" + std::to_string(i));
+	BOOST_CHECK_EQUAL(second_stats.corrupted_segments, 1u);
+	BOOST_CHECK(second_stats.completed);
+	BOOST_CHECK(!std::filesystem::exists(damaged));
+	BOOST_CHECK(std::filesystem::exists(damaged + ".corrupt"));
+
+	//the damaged segment is not replayed again
+	in_memory_plate_sink third_sink;
+	const auto third_stats = replayer.replay(third_sink, journal.active_sequence());
+	BOOST_CHECK(third_sink.plates().empty());
+	BOOST_CHECK_EQUAL(third_stats.segments, 0u);
+	BOOST_CHECK(std::filesystem::exists(damaged + ".corrupt"));
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+}
+
+BOOST_AUTO_TEST_CASE(journal_keeps_segments_it_cannot_read)
+{
+	const auto directory = std::filesystem::temp_directory_path() / "raven_anpr_unreadable_journal_test";
+	std::filesystem::remove_all(directory);
+	std::filesystem::create_directories(directory);
+
+	//the first segment never got its header (a crash right after it was created), it is empty
+	std::ofstream(directory / plate_journal::segment_file_name(1)).close();
+
+	//the second one can't be opened - a directory of the same name fails like a file without the permissions would
+	const auto unreadable = directory / plate_journal::segment_file_name(2);
+	std::filesystem::create_directory(unreadable);
+
+	plate_journal journal(directory.string());
+	for(auto i = 0; i < 10; i++)
+		journal.append(plate { "EF" + std::to_string(i), 0 });
+	journal.rotate();
+
+	//the empty segment is gone, the unreadable one stops the replay and stays (with everything after it)
+	in_memory_plate_sink sink;
+	const plate_journal_replayer replayer(directory.string());
+	const auto stats = replayer.replay(sink, journal.active_sequence());
+	BOOST_CHECK(!stats.completed);
+	BOOST_CHECK_EQUAL(stats.segments, 1u);
+	BOOST_CHECK(sink.plates().empty());
+	BOOST_CHECK(!std::filesystem::exists(directory / plate_journal::segment_file_name(1)));
+	BOOST_CHECK(std::filesystem::exists(unreadable));
+	BOOST_CHECK_EQUAL(plate_journal::list_segments(directory.string()).size(), 3u);
+
+	//once it can be read (here: once it is out of the way), the replay goes on where it stopped
+	std::filesystem::remove(unreadable);
+	const auto second_stats = replayer.replay(sink, journal.active_sequence());
+	BOOST_CHECK(second_stats.completed);
+	BOOST_CHECK_EQUAL(sink.plates().size(), 10u);
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+}
+
+BOOST_AUTO_TEST_CASE(sighting_index_rolls_repeated_reads_into_one_sighting)
+{
+	sighting_options options;
+	options.window = std::chrono::seconds(10);
+	sighting_index index(options);
+
+	//the same plate from a few frames and another camera, with a different spelling
+	BOOST_CHECK(index.observe("AB-123", 100, 50));
+	BOOST_CHECK(!index.observe("ab 123", 105, 80));
+	BOOST_CHECK(!index.observe("AB123", 103, 60));
+	BOOST_CHECK(index.observe("XY999", 104, 40));
+
+	std::vector<sighting> closed;
+	index.expire(114, closed);
+	BOOST_CHECK(closed.empty());
+
+	index.expire(115, closed);
+	BOOST_REQUIRE_EQUAL(closed.size(), 1u);
+	BOOST_CHECK_EQUAL(closed[0].number, "XY999");
+
+	//back after a gap, that is another sighting
+	BOOST_CHECK(index.observe("AB123", 130, 30));
+	index.expire(135, closed);
+	BOOST_REQUIRE_EQUAL(closed.size(), 2u);
+	BOOST_CHECK_EQUAL(closed[1].number, "AB123");
+	BOOST_CHECK_EQUAL(closed[1].first_seen, 100);
+	BOOST_CHECK_EQUAL(closed[1].last_seen, 105);
+	BOOST_CHECK_EQUAL(closed[1].best_confidence, 80);
+	BOOST_CHECK_EQUAL(closed[1].reads, 3u);
+
+	sighting open;
+	BOOST_REQUIRE(index.find("ab-123", open));
+	BOOST_CHECK_EQUAL(open.first_seen, 130);
+
+	index.close_all(closed);
+	const auto stats = index.statistics();
+	BOOST_CHECK_EQUAL(closed.size(), 3u);
+	BOOST_CHECK_EQUAL(stats.reads, 5u);
+	BOOST_CHECK_EQUAL(stats.sightings_closed, 3u);
+	BOOST_CHECK_EQUAL(stats.open_sightings, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(sighting_index_rolls_late_reads_into_the_sighting_they_belong_to)
+{
+	sighting_options options;
+	options.window = std::chrono::seconds(10);
+	sighting_index index(options);
+
+	BOOST_CHECK(index.observe("AB123", 100, 50));
+	BOOST_CHECK(!index.observe("AB123", 104, 70));
+
+	//a slow camera is a few seconds late, that is still the same car
+	BOOST_CHECK(!index.observe("AB123", 95, 60));
+
+	//a camera that was offline sends what it read long before, that car passed by earlier
+	BOOST_CHECK(index.observe("AB123", 40, 90));
+
+	//...and the rest of what it read then joins that earlier sighting, not one of its own per read
+	BOOST_CHECK(!index.observe("AB123", 42, 85));
+	BOOST_CHECK(!index.observe("AB123", 45, 80));
+	BOOST_CHECK(!index.observe("AB123", 38, 75));
+
+	sighting open;
+	BOOST_REQUIRE(index.find("AB123", open));
+	BOOST_CHECK_EQUAL(open.first_seen, 95);
+	BOOST_CHECK_EQUAL(open.last_seen, 104);
+	BOOST_CHECK_EQUAL(open.best_confidence, 70);
+	BOOST_CHECK_EQUAL(open.reads, 3u);
+
+	//the earlier sighting is long over, it is closed right away - the open one isn't
+	std::vector<sighting> closed;
+	index.expire(105, closed);
+	BOOST_REQUIRE_EQUAL(closed.size(), 1u);
+	BOOST_CHECK_EQUAL(closed[0].first_seen, 38);
+	BOOST_CHECK_EQUAL(closed[0].last_seen, 45);
+	BOOST_CHECK_EQUAL(closed[0].best_confidence, 90);
+	BOOST_CHECK_EQUAL(closed[0].reads, 4u);
+	BOOST_CHECK(index.find("AB123", open));
+
+	//the database gets the whole sighting, not just when it started
+	index.close_all(closed);
+	BOOST_REQUIRE_EQUAL(closed.size(), 2u);
+	const auto record = closed[1].record();
+	BOOST_CHECK_EQUAL(record.number, "AB123");
+	BOOST_CHECK_EQUAL(record.when_taken, 95);
+	BOOST_CHECK_EQUAL(record.last_seen, 104);
+	BOOST_CHECK_EQUAL(record.confidence, 70);
+	BOOST_CHECK_EQUAL(record.reads, 3u);
+
+	const auto stats = index.statistics();
+	BOOST_CHECK_EQUAL(stats.reads, 7u);
+	BOOST_CHECK_EQUAL(stats.sightings_opened, 2u);
+	BOOST_CHECK_EQUAL(stats.open_sightings, 0u);
+}
+
+BOOST_AUTO_TEST_CASE(watchlist_matches_reads_with_ocr_mistakes)
+{
+	watchlist_matcher matcher(watchlist::build({ { "AB-123-CD", "stolen" }, { "XY987ZZ", "expired" } }));
+
+	std::vector<watchlist_match> matches;
+	BOOST_REQUIRE(matcher.find("ab 123 cd", matches));
+	BOOST_CHECK_EQUAL(matches[0].label, "stolen");
+	BOOST_CHECK_EQUAL(matches[0].distance, 0);
+	BOOST_CHECK(matches[0].exact);
+
+	//look-alike characters cost nothing
+	BOOST_REQUIRE(matcher.find("A8I23C0", matches));
+	BOOST_CHECK_EQUAL(matches[0].number, "AB-123-CD");
+	BOOST_CHECK_EQUAL(matches[0].distance, 0);
+	BOOST_CHECK(!matches[0].exact);
+
+	//a missing or extra character is one edit
+	BOOST_REQUIRE(matcher.find("XY987Z", matches));
+	BOOST_CHECK_EQUAL(matches[0].distance, 1);
+	BOOST_REQUIRE(matcher.find("AB1234CD", matches));
+	BOOST_CHECK_EQUAL(matches[0].distance, 1);
+
+	BOOST_CHECK(!matcher.find("XY9", matches));
+	BOOST_CHECK(!matcher.find("AB12XYCD", matches));
+
+	//a reload swaps the whole list, a snapshot taken before keeps the old one
+	const auto before = matcher.snapshot();
+	matcher.reload(watchlist::build({ { "XY9", "new" } }, 0));
+	BOOST_CHECK(matcher.find("XY9", matches));
+	BOOST_CHECK(!matcher.find("AB123CD", matches));
+	BOOST_CHECK(before->find("AB123CD", matches));
+}
+
+BOOST_AUTO_TEST_CASE(recognition_result_keeps_the_best_read_of_each_plate)
+{
+	const auto read_of = [](const std::string& text, const int confidence)
+	{
+		ocr_read read;
+		read.succeeded = true;
+		read.text = text;
+		read.confidence = confidence;
+		return read;
+	};
+
+	recognition_result result(3);
+	BOOST_CHECK(result.add(read_of("AB123CD", 60), cv::Rect(10, 20, 100, 30), 1));
+	BOOST_CHECK(!result.add(read_of("AB123CD", 50), cv::Rect(0, 0, 10, 10), 0));
+	BOOST_CHECK(result.add(read_of("XY987ZW", 70), cv::Rect(200, 20, 100, 30), 0));
+	BOOST_CHECK(result.add(read_of("AB123CD", 80), cv::Rect(12, 22, 100, 30), 2));
+	BOOST_CHECK(!result.add(read_of(std::string(recognized_plate::max_text_length + 1, 'A'), 99)));
+	BOOST_CHECK_EQUAL(result.size(), 2u);
+	BOOST_CHECK_EQUAL(result.too_long_count(), 1u);
+	BOOST_CHECK_EQUAL(result.dropped_count(), 0u);
+	BOOST_CHECK(result.overflowed());
+
+	//the better read of a plate takes over its region and strategy too
+	const auto best = result.find("AB123CD");
+	BOOST_REQUIRE(best != nullptr);
+	BOOST_CHECK_EQUAL(best->confidence, 80);
+	BOOST_CHECK(best->region == cv::Rect(12, 22, 100, 30));
+	BOOST_CHECK_EQUAL(best->strategy_index, 2u);
+
+	//a full result makes room only for reads better than its weakest entry
+	BOOST_CHECK(result.add(read_of("KL555MN", 40)));
+	BOOST_CHECK(!result.add(read_of("QR111ST", 30)));
+	BOOST_CHECK(result.add(read_of("UV222WX", 90)));
+	BOOST_CHECK_EQUAL(result.size(), 3u);
+	BOOST_CHECK_EQUAL(result.dropped_count(), 2u);
+	BOOST_CHECK(result.find("KL555MN") == nullptr);
+	BOOST_CHECK(result.find("AB123CD") != nullptr);
+
+	result.sort_by_confidence();
+	BOOST_CHECK_EQUAL(result[0].number(), "UV222WX");
+	BOOST_CHECK_EQUAL(result[2].number(), "XY987ZW");
+	BOOST_CHECK(result.find("XY987ZW") == &result[2]);
+
+	//the multimap form skips numbers it already has with at least the same confidence
+	std::multimap<int, std::string, std::greater<int>> numbers { { 95, "UV222WX" }, { 10, "XY987ZW" } };
+	result.append_to(numbers);
+	BOOST_CHECK_EQUAL(numbers.size(), 4u);
+	BOOST_CHECK_EQUAL(numbers.count(70), 1u);
+
+	result.clear();
+	BOOST_CHECK(result.empty());
+	BOOST_CHECK(!result.overflowed());
+	BOOST_CHECK(result.find("UV222WX") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(multimap_results_keep_the_reads_a_result_has_no_room_for)
+{
+	//more plates than a result has room for, in a grid - the region of a candidate tells the backend which one it is
+	static constexpr auto plate_count = recognition_result::default_capacity + 8;
+	struct grid_strategy final : base_plate_finder_strategy
+	{
+		using base_plate_finder_strategy::try_find_and_crop_plate_number;
+
+		bool try_find_and_crop_plate_number(frame_context& frame, std::vector<plate_candidate>& results) override
+		{
+			for(size_t i = 0; i <= plate_count; i++)
+			{
+				plate_candidate candidate;
+				candidate.region = cv::Rect(static_cast<int>(i % 10) * 100, static_cast<int>(i / 10) * 50, 90, 30);
+				candidate.image = frame.gray()(candidate.region).clone();
+				results.push_back(candidate);
+			}
+			return true;
+		}
+	};
+
+	//a distinct number per candidate, each more confident than the one before - and one more that is way too long
+	struct grid_backend final : ocr_backend
+	{
+		bool try_read(const plate_candidate& candidate, ocr_read& read) override
+		{
+			const auto index = static_cast<size_t>(candidate.region.x / 100 + candidate.region.y / 50 * 10);
+			read.text = index < plate_count ? "PL" + std::to_string(index) : std::string(recognized_plate::max_text_length + 1, 'X');
+			read.confidence = 40 + static_cast<int>(index);
+			return read.succeeded = true;
+		}
+
+		size_t concurrency() const override { return 1; }
+	};
+
+	plate_recognizer grid_recognizer(
+		std::vector<std::shared_ptr<base_plate_finder_strategy>> {
+			std::static_pointer_cast<base_plate_finder_strategy>(std::make_shared<grid_strategy>())
+		}, std::make_shared<grid_backend>());
+
+	const cv::Mat image(300, 1000, CV_8UC3, cv::Scalar(128, 128, 128));
+
+	//the result has room for the most confident plates only, the rest is counted
+	recognition_result result;
+	BOOST_CHECK_EQUAL(true, grid_recognizer.try_parse(image, result, 0));
+	BOOST_CHECK_EQUAL(result.size(), recognition_result::default_capacity);
+	BOOST_CHECK_EQUAL(result.dropped_count(), 8u);
+	BOOST_CHECK_EQUAL(result.too_long_count(), 1u);
+	BOOST_CHECK(result.find("PL" + std::to_string(plate_count - 1)) != nullptr);
+	BOOST_CHECK(result.find("PL0") == nullptr);
+
+	//the multimap gets all of them, just like before there was a result
+	std::multimap<int, std::string, std::greater<int>> numbers;
+	BOOST_CHECK_EQUAL(true, grid_recognizer.try_parse(image, numbers, 0));
+	BOOST_CHECK_EQUAL(numbers.size(), plate_count + 1);
+	BOOST_CHECK_EQUAL(numbers.begin()->second, std::string(recognized_plate::max_text_length + 1, 'X'));
+	BOOST_CHECK_EQUAL(numbers.rbegin()->second, "PL0");
+
+	//merging reads keeps every number, and a more confident read of a number next to the earlier one
+	std::vector<ocr_read> reads(plate_count + 1);
+	for(size_t i = 0; i < reads.size(); i++)
+	{
+		reads[i].text = i < plate_count ? "PL" + std::to_string(i) : std::string(recognized_plate::max_text_length + 1, 'X');
+		reads[i].confidence = 40;
+		reads[i].succeeded = true;
+	}
+
+	reads.push_back(reads[0]);
+	reads.push_back(reads[0]);
+	reads.back().confidence = 50;
+
+	numbers.clear();
+	plate_recognizer::merge_reads(reads, numbers, 0);
+	BOOST_CHECK_EQUAL(numbers.size(), plate_count + 2);
+	BOOST_CHECK_EQUAL(numbers.begin()->first, 50);
+	BOOST_CHECK_EQUAL(numbers.begin()->second, "PL0");
+	BOOST_CHECK_EQUAL(numbers.count(40), plate_count + 1);
+}
+
+BOOST_AUTO_TEST_CASE(can_recognize_plate_into_recognition_result)
+{
+	recognition_result result;
+	BOOST_CHECK_EQUAL(true, recognizer->try_parse("test_license_plate.jpg", result));
+	BOOST_REQUIRE(!result.empty());
+
+	//the same plate as through the multimap overload, with where it was found
+	std::multimap<int, std::string, std::greater<int>> results;
+	BOOST_CHECK_EQUAL(true, recognizer->try_parse("test_license_plate.jpg", results));
+	BOOST_CHECK_EQUAL(result[0].number(), results.begin()->second);
+	BOOST_CHECK_EQUAL(result[0].confidence, results.begin()->first);
+	BOOST_CHECK(result[0].region.area() > 0);
+
+	//a reused result starts over
+	BOOST_CHECK_EQUAL(false, recognizer->try_parse("test_license_plate_missing.jpg", result));
+	BOOST_CHECK(result.empty());
+}
+
 BOOST_AUTO_TEST_CASE(can_recognize_missing_plate)
 {
 	std::multimap<int, std::string, std::greater<int>> results;